@@ -12,275 +12,705 @@
  ***************************************************************************/
 
 #include "DHT.h"
+#include "string.h"
 
-DHT::DHT(uint8_t pin, uint8_t type) {
+// DHT_BIT_THRESHOLD_MICROS/DHT_TIMING_REFERENCE_MICROS, as a 16-bit fixed
+// point fraction
+#define DHT_THRESHOLD_SCALE ((DHT_BIT_THRESHOLD_MICROS*65536UL + DHT_TIMING_REFERENCE_MICROS/2) / DHT_TIMING_REFERENCE_MICROS)
+
+// correctBits() only considers this many of the least reliable bits, and
+// only those within a third of the threshold of it
+#define DHT_CORRECTION_CANDIDATES 3
+
+// data[0] is a checksum byte, and should equal the low byte of the sum of the
+// other 4 bytes
+static inline boolean checksumMatches(const uint8_t *data) {
+	return DHTFrame::checksumMatches(data);
+}
+
+// bits are numbered in the order they're sent, high-order bits first, and
+// the bytes are stored "backwards"; see DHT::decodePulses()
+static inline void flipBit(uint8_t *data, uint8_t bit) {
+	data[DHT_NUM_BYTES-1 - bit/8] ^= 0x80 >> (bit%8);
+}
+
+#if DHT_ENABLE_STATS
+// counters stick at their maximum, so a long-running sensor's numbers stay
+// meaningful (if not exact) rather than wrapping back around to small ones
+static inline void incrementStat(uint16_t &counter) {
+	if (counter < 0xFFFF) {
+		counter++;
+	}
+}
+#endif
+
+DHTCore::DHTCore(uint8_t pin) {
 	pin_ = pin;
-	type_ = type;
 	firstReading_ = true;
 	validData_ = false;
-
-	switch (type_) {
-		case DHT_SENSOR_TYPE_DHT11:
-			minSampleDelayMillis_ = 1000;
-			break;
-		case DHT_SENSOR_TYPE_DHT21:
-		case DHT_SENSOR_TYPE_DHT22:
-			minSampleDelayMillis_ = 2000;
-			break;
-	}
+	corrected_ = false;
+	generation_ = 0;
+	readPhase_ = DHT_PHASE_IDLE;
+	readStatus_ = DHT_READ_NOT_STARTED;
+	numPulses_ = 0;
+	noResponseCount_ = 0;
+	maxRetries_ = 0;
+	retrySpacingMillis_ = 0;
+	maxAgeMillis_ = 0;
+	haveGoodData_ = false;
+	lastGoodTime_ = 0;
+#if DHT_ENABLE_STATS
+	resetStats();
+#endif
+	memset(data_, 0, sizeof(data_));
 }
 
-void DHT::begin() {
+void DHTCore::begin() {
 	// set up the pins!
 	pinMode(pin_, INPUT);
 	digitalWrite(pin_, HIGH);
 	lastReadTime_ = 0;
 }
 
-boolean DHT::readSensorData() {
-	int8_t byteIndex, bitIndex;
-	int8_t bit;
+boolean DHTCore::waitToRetry(uint8_t attempt, uint16_t minSampleDelayMillis) {
+	uint16_t spacing;
+
+	// there's no point hammering a sensor that isn't there
+	if (readStatus_ == DHT_READ_OK || readStatus_ == DHT_READ_DISCONNECTED || attempt >= maxRetries_) {
+#if DHT_ENABLE_STATS
+		// this was the last try, so if it fell back to the last good value,
+		// that's the one fallback this readSensorData() made
+		recordFallback();
+#endif
+		return false;
+	}
+
+	// never try again sooner than the sensor allows
+	spacing = minSampleDelayMillis;
+	if (retrySpacingMillis_ > spacing) {
+		spacing = retrySpacingMillis_;
+	}
+	delay(spacing);
+	return true;
+}
+
+void DHTCore::setRetryPolicy(uint8_t maxRetries, uint16_t retrySpacingMillis, unsigned long maxAgeMillis) {
+	maxRetries_ = maxRetries;
+	retrySpacingMillis_ = retrySpacingMillis;
+	maxAgeMillis_ = maxAgeMillis;
+}
+
+unsigned long DHTCore::getValueTimestamp() {
+	return lastGoodTime_;
+}
+
+unsigned long DHTCore::getValueAgeMillis() {
+	// because these are unsigned values, this works even for rollovers
+	return millis() - lastGoodTime_;
+}
+
+boolean DHTCore::isDisconnected() {
+	return noResponseCount_ >= DHT_DISCONNECT_THRESHOLD;
+}
+
+unsigned long DHTCore::getSampleWindowMillis(uint16_t minSampleDelayMillis) {
+	uint8_t backoffShift;
+
+	// a disconnected sensor's window grows with every failure
+	backoffShift = 0;
+	if (isDisconnected()) {
+		backoffShift = noResponseCount_ - DHT_DISCONNECT_THRESHOLD;
+		if (backoffShift > DHT_MAX_BACKOFF_SHIFT) {
+			backoffShift = DHT_MAX_BACKOFF_SHIFT;
+		}
+	}
+	return (unsigned long)minSampleDelayMillis << backoffShift;
+}
+
+boolean DHTCore::isReadDue(uint16_t minSampleDelayMillis) {
+	// because these are unsigned values, this works even for rollovers
+	return readPhase_ == DHT_PHASE_IDLE && (firstReading_ || (millis() - lastReadTime_) >= getSampleWindowMillis(minSampleDelayMillis));
+}
+
+boolean DHTCore::isReadInProgress() {
+	return readPhase_ != DHT_PHASE_IDLE;
+}
+
+boolean DHTCore::isBurstDue() {
+	// because these are unsigned values, this works even for rollovers
+	return readPhase_ == DHT_PHASE_START_SIGNAL && (millis() - phaseStartTime_) >= startSignalMillis_;
+}
+
+void DHTCore::cancelRead(uint8_t type) {
+	// a DHTArray read isn't ours to cancel
+	if (readPhase_ == DHT_PHASE_IDLE || readPhase_ == DHT_PHASE_EXTERNAL) {
+		return;
+	}
+	// let the line float back up, just as at the end of the start signal
+	digitalWrite(pin_, HIGH);
+	pinMode(pin_, INPUT);
+	readPhase_ = DHT_PHASE_IDLE;
+	readStatus_ = DHT_READ_NOT_STARTED;
+	useLastGoodData();
+#if DHT_ENABLE_STATS
+	recordFallback();
+#endif
+#if DHT_ENABLE_SNAPSHOT
+	publishSnapshot(readStatus_, type);
+#endif
+}
+
+boolean DHTCore::startRead(uint8_t type, uint16_t minSampleDelayMillis) {
+	if (readPhase_ != DHT_PHASE_IDLE) {
+		// a read is already in flight
+		return true;
+	}
 
 	// Check if sensor was read in the last sample window, and if so return
 	// early to use the values from the last reading
-	// because these are unsigned values, this works even for rollovers
-	if (!firstReading_ && ((millis() - lastReadTime_) < minSampleDelayMillis_)) {
-		// we're not going to ask the sensor for more data, so just return a
-		// value indicating whether the data currently in the buffer is valid
-		return validData_;
+	if (!isReadDue(minSampleDelayMillis)) {
+		// we're not going to ask the sensor for more data
+#if DHT_ENABLE_STATS
+		if (isDisconnected()) {
+			incrementStat(stats_.backoffSkips);
+		} else {
+			incrementStat(stats_.cacheHits);
+		}
+#endif
+		return false;
 	}
+
+	// record current time
+	lastReadTime_ = millis();
+	phaseStartTime_ = lastReadTime_;
+
+	// set flag to show we haven't gotten valid data from this read
+	validData_ = false;
+
+	// pull the pin high and let the sensor chill out; poll() will send the
+	// start signal once the delay has passed
+	// the original library had a delay of 250 milliseconds here, but nothing
+	// in the datasheets or elsewhere seem to indicate that's necessary, so
+	// we only use the long delay for the very first reading
+	digitalWrite(pin_, HIGH);
+	startDelayMillis_ = firstReading_ ? DHT_FIRST_START_DELAY : DHT_LATER_START_DELAYS;
+	startSignalMillis_ = DHT_START_SIGNAL_MILLIS;
 	firstReading_ = false;
 
-	// clear the buffer, disable interrupts, signal the sensor, etc
-	if (!prepareRead()) {
-		// something's wrong; turn interrupts back on and bail
-		interrupts();
-		return false;
+	// if the sensor is disconnected, just probe for it as quickly as it
+	// could possibly answer
+	if (isDisconnected()) {
+		startDelayMillis_ = 0;
+		if (type != DHT_SENSOR_TYPE_DHT11) {
+			startSignalMillis_ = DHT_PROBE_SIGNAL_MILLIS;
+		}
 	}
 
-	// get our data bits: they come out high-order bits first, so we have to
-	// write them into the buffer "backwards"
-	for (byteIndex = DHT_NUM_BYTES-1; byteIndex >= 0; byteIndex--) {
-		for (bitIndex = 7; bitIndex >= 0; bitIndex--) {
-			bit = readBit();
-			if (bit == -1) {
-				// that didn't work; turn interrupts back on and bail
-				interrupts();
-				return false;
+	readPhase_ = DHT_PHASE_START_DELAY;
+	readStatus_ = DHT_READ_IN_PROGRESS;
+	return true;
+}
+
+boolean DHTCore::advanceRead() {
+	// because these are unsigned values, the elapsed time checks below work
+	// even for rollovers
+	switch (readPhase_) {
+		case DHT_PHASE_START_DELAY:
+			if (millis() - phaseStartTime_ < startDelayMillis_) {
+				break;
 			}
-			// write the bit into the appropriate location in the buffer
-			data_[byteIndex] |= (bit<<bitIndex);
-		}
+			// now pull it low for ~20 milliseconds as the start signal
+			pinMode(pin_, OUTPUT);
+			digitalWrite(pin_, LOW);
+			phaseStartTime_ = millis();
+			readPhase_ = DHT_PHASE_START_SIGNAL;
+			break;
+		case DHT_PHASE_START_SIGNAL:
+			// time for the burst
+			return millis() - phaseStartTime_ >= startSignalMillis_;
 	}
+	return false;
+}
 
-	// turn interrupts back on
-	interrupts();
+void DHTCore::beginExternalRead(unsigned long startTime) {
+	// the same bookkeeping startRead() does, but poll() leaves the line alone
+	// until finishExternalRead()
+	lastReadTime_ = startTime;
+	firstReading_ = false;
+	validData_ = false;
+	readPhase_ = DHT_PHASE_EXTERNAL;
+	readStatus_ = DHT_READ_IN_PROGRESS;
+}
+
+void DHTCore::finishExternalRead(uint8_t type, DHTPlausibilityCheck isPlausible) {
+	readStatus_ = decodeCapture(type, isPlausible);
+	readPhase_ = DHT_PHASE_IDLE;
+#if DHT_ENABLE_STATS
+	recordFallback();
+#endif
+}
 
-	// test for data validity: data_[0] is a checksum byte, and should equal
-	// the low byte of the sum of the other 4 bytes
-	validData_ = (data_[0] == ((data_[1] + data_[2] + data_[3] + data_[4]) & 0xFF));
+void DHTCore::finishRead(uint8_t numPulses, uint8_t type, DHTPlausibilityCheck isPlausible, boolean countFallback) {
+	// the sensor's signals were recorded as quickly as we could, with
+	// interrupts off; all the real work is saved for after they're back on
+	numPulses_ = numPulses;
+	interrupts();
 
-	return validData_;
+	readStatus_ = decodeCapture(type, isPlausible);
+	readPhase_ = DHT_PHASE_IDLE;
+#if DHT_ENABLE_STATS
+	if (countFallback) {
+		recordFallback();
+	}
+#endif
 }
 
-float DHT::getTemperatureCelsius() {
-	float temperature;
+uint8_t DHTCore::decodeCapture(uint8_t type, DHTPlausibilityCheck isPlausible) {
+	uint8_t data[DHT_NUM_BYTES];
+	uint8_t status;
 
-	if (!validData_) {
-		return NAN;
+	corrected_ = false;
+	if (numPulses_ == 0 && pulses_[0] == 0) {
+		// the sensor never answered at all (see getPulseWidths()); once
+		// that's happened enough times in a row, call it disconnected
+		if (noResponseCount_ < 0xFF) {
+			noResponseCount_++;
+		}
+		status = isDisconnected() ? DHT_READ_DISCONNECTED : DHT_READ_TIMEOUT;
+	} else if (numPulses_ < DHT_NUM_PULSES) {
+		// we never saw the end of some signal, oops
+		noResponseCount_ = 0;
+		status = DHT_READ_TIMEOUT;
+	} else {
+		noResponseCount_ = 0;
+
+		// decode into a scratch buffer, so a bad read can't clobber the last
+		// good data
+		validData_ = decodePulses(pulses_, data);
+#if DHT_ERROR_CORRECTION_BITS > 0
+		if (!validData_) {
+			// rather than wait for the next sample window, see whether a bit
+			// or two that were nearly read the other way can fix things
+			corrected_ = correctBits(pulses_, data, isPlausible);
+			validData_ = corrected_;
+		}
+#endif
+		status = validData_ ? DHT_READ_OK : DHT_READ_CHECKSUM_ERROR;
 	}
 
-	// different versions of the sensor yield data in different formats
-	switch (type_) {
-		case DHT_SENSOR_TYPE_DHT11:
-			// data is in whole degrees, and fits in a byte, convenient!
-			return data_[2];
-		case DHT_SENSOR_TYPE_DHT21:
-		case DHT_SENSOR_TYPE_DHT22:
-			// NOTE: negative temperatures are transmitted using a "signed"
-			// integer format: the highest-order bit indicates the sign of the
-			// number (0==positive, 1==negative), and the rest of the bits
-			// have the same value as they would for the absolute value of the
-			// number in question.
-			// Example: for a 16-bit value, we would have
-			//     0x016F == 0b0000000101101111 ==  367
-			//     0x816F == 0b1000000101101111 == -367
-			// This is not how most computers store negative numbers, so we
-			// have to be careful to deal properly with these
-
-			// mask the sign bit off data_[2], then shift it left 8 bits, and
-			// drop data_[3] into the low-order byte
-			temperature = ((data_[2] & 0x7F) << 8) ^ data_[1];
-
-			// Now put the correct sign on the float value
-			if (data_[2] & 0x80) {
-				temperature = -temperature;
-			}
-			// raw data is in tenths of degrees, so scale the result
-			return temperature/10.0;
+	if (status == DHT_READ_OK) {
+		memcpy(data_, data, DHT_NUM_BYTES);
+		generation_++;
+		haveGoodData_ = true;
+		lastGoodTime_ = millis();
+	} else {
+		useLastGoodData();
 	}
-	return NAN;
+
+#if DHT_ENABLE_STATS
+	recordStats(status);
+#endif
+#if DHT_ENABLE_SNAPSHOT
+	publishSnapshot(status, type);
+#endif
+	return status;
 }
 
-float DHT::getTemperatureFahrenheit() {
-	return DHT_TempHumidUtils::convertCelsiusToFahrenheit(getTemperatureCelsius());
+#if DHT_ENABLE_SNAPSHOT
+void DHTCore::publishSnapshot(uint8_t status, uint8_t type) {
+	DHTSnapshot snapshot;
+
+	snapshot.frame.type = type;
+	memcpy(snapshot.frame.data, data_, DHT_NUM_BYTES);
+	snapshot.valid = validData_;
+	snapshot.status = status;
+	snapshot.generation = generation_;
+	snapshot.timestamp = lastGoodTime_;
+	snapshot_.publish(snapshot);
 }
 
-float DHT::getPercentHumidity() {
-	float humidity;
+boolean DHTCore::getSnapshot(DHTSnapshot &snapshot) {
+	snapshot_.read(snapshot);
+	return snapshot.valid;
+}
+#endif
 
-	if (!validData_) {
-		return NAN;
+boolean DHTCore::useLastGoodData() {
+	// the last good value can stand in for a failed read if it's recent
+	// enough; because these are unsigned values, this works even for
+	// rollovers
+	if (!haveGoodData_ || maxAgeMillis_ == 0 || (millis() - lastGoodTime_) > maxAgeMillis_) {
+		return false;
 	}
+	validData_ = true;
+	return true;
+}
+
+const uint8_t* DHTCore::getPulseWidths() {
+	return pulses_;
+}
 
-	switch (type_) {
-		case DHT_SENSOR_TYPE_DHT11:
-			// data is in whole percents, and fits in a byte, convenient!
-			return data_[4];
-		case DHT_SENSOR_TYPE_DHT21:
-		case DHT_SENSOR_TYPE_DHT22:
-			// shift data_[4] left 8 bits, and drop data_[3] into the low-order byte
-			humidity = (data_[4] << 8) ^ data_[3];
-			// raw data is in tenths of a percent, so scale the result
-			return humidity/10.0;
+uint8_t DHTCore::getNumPulses() {
+	return numPulses_;
+}
+
+boolean DHTCore::wasCorrected() {
+	return corrected_;
+}
+
+uint16_t DHTCore::getGeneration() {
+	return generation_;
+}
+
+/* static */ boolean DHTCore::decodePulses(const uint8_t *pulses, uint8_t *data) {
+	uint8_t threshold = computeBitThreshold(pulses);
+	int8_t byteIndex, bitIndex;
+
+	// skip the response signals and the first bit's LOW signal; from there,
+	// every other signal is the HIGH signal of a bit, which lasts for:
+	//     ~26-28 microseconds for a "0" bit
+	//     ~70 microseconds for a "1" bit
+	// (or proportionally more or less, if the timing is off; see
+	// computeBitThreshold())
+	pulses += 3;
+
+	// the bits come out high-order bits first, so we have to write them
+	// into the buffer "backwards"
+	for (byteIndex = DHT_NUM_BYTES-1; byteIndex >= 0; byteIndex--) {
+		data[byteIndex] = 0;
+		for (bitIndex = 7; bitIndex >= 0; bitIndex--) {
+			if (*pulses >= threshold) {
+				data[byteIndex] |= (1<<bitIndex);
+			}
+			pulses += 2;
+		}
 	}
-	return NAN;
+
+	// test for data validity
+	return checksumMatches(data);
 }
 
+/* static */ uint8_t DHTCore::computeBitThreshold(const uint8_t *pulses) {
+#if DHT_ADAPTIVE_THRESHOLD
+	uint16_t total;
+	uint32_t threshold;
+	uint8_t pulseIndex;
+
+	// add up the response HIGH and every bit's LOW; the response LOW isn't
+	// used, because it can start before we begin watching the line
+	total = pulses[1];
+	for (pulseIndex = 2; pulseIndex < DHT_NUM_PULSES; pulseIndex += 2) {
+		total += pulses[pulseIndex];
+	}
 
-float DHT::readTemperatureCelsius() {
-	// read in raw data, and check for failure
-	if (!readSensorData()) {
-		return NAN;
+	// scale the nominal threshold by total/DHT_TIMING_REFERENCE_MICROS,
+	// using a 16-bit fixed point factor so there's no division at runtime
+	threshold = ((uint32_t)total * DHT_THRESHOLD_SCALE + 0x8000) >> 16;
+
+	// a stalled or garbled read can give nonsense, so only trust a threshold
+	// within a factor of 2 of the nominal one
+	if (threshold >= DHT_BIT_THRESHOLD_MICROS/2 && threshold <= DHT_BIT_THRESHOLD_MICROS*2) {
+		return threshold;
 	}
-	return getTemperatureCelsius();
+#endif
+	return DHT_BIT_THRESHOLD_MICROS;
 }
 
-float DHT::readTemperatureFahrenheit() {
-	return DHT_TempHumidUtils::convertCelsiusToFahrenheit(readTemperatureCelsius());
+/* static */ boolean DHTCore::correctBits(const uint8_t *pulses, uint8_t *data, boolean (*isPlausible)(const uint8_t *data)) {
+#if DHT_ERROR_CORRECTION_BITS > 0
+	uint8_t candidates[DHT_CORRECTION_CANDIDATES];
+	uint8_t margins[DHT_CORRECTION_CANDIDATES];
+	uint8_t numCandidates = 0;
+	uint8_t threshold, width, margin, bit, i;
+#if DHT_ERROR_CORRECTION_BITS > 1
+	uint8_t j;
+#endif
+
+	// find the least reliable bits, keeping them sorted with the weakest
+	// first; with so few of them, insertion is as good as anything
+	threshold = computeBitThreshold(pulses);
+	for (bit = 0; bit < DHT_NUM_BYTES*8; bit++) {
+		width = pulses[3 + 2*bit];
+		margin = (width < threshold) ? threshold - width : width - threshold;
+		if (margin > threshold/3) {
+			continue;
+		}
+		if (numCandidates < DHT_CORRECTION_CANDIDATES) {
+			numCandidates++;
+		} else if (margin >= margins[DHT_CORRECTION_CANDIDATES-1]) {
+			continue;
+		}
+		for (i = numCandidates-1; i > 0 && margins[i-1] > margin; i--) {
+			margins[i] = margins[i-1];
+			candidates[i] = candidates[i-1];
+		}
+		margins[i] = margin;
+		candidates[i] = bit;
+	}
+
+	// a single bad bit is far more likely than two, so try those first
+	for (i = 0; i < numCandidates; i++) {
+		flipBit(data, candidates[i]);
+		if (checksumMatches(data) && isPlausible(data)) {
+			return true;
+		}
+		flipBit(data, candidates[i]);
+	}
+
+#if DHT_ERROR_CORRECTION_BITS > 1
+	for (i = 0; i < numCandidates; i++) {
+		flipBit(data, candidates[i]);
+		for (j = i+1; j < numCandidates; j++) {
+			flipBit(data, candidates[j]);
+			if (checksumMatches(data) && isPlausible(data)) {
+				return true;
+			}
+			flipBit(data, candidates[j]);
+		}
+		flipBit(data, candidates[i]);
+	}
+#endif
+#endif
+
+	return false;
 }
 
-float DHT::readPercentHumidity() {
-	// read in raw data, and check for failure
-	if (!readSensorData()) {
+float DHTFrame::getTemperatureCelsius() const {
+	if (!isChecksumValid()) {
 		return NAN;
 	}
-	return getPercentHumidity();
+	return decodeTemperatureTenths(type, data)/10.0;
 }
 
-float DHT::readHeatIndexFahrenheit() {
-	// read in raw data, and check for failure
-	if (!readSensorData()) {
+float DHTFrame::getPercentHumidity() const {
+	if (!isChecksumValid()) {
 		return NAN;
 	}
-	return DHT_TempHumidUtils::computeHeatIndexFahrenheit(getTemperatureFahrenheit(), getPercentHumidity());
+	return decodeHumidityTenths(type, data)/10.0;
 }
 
-float DHT::readHeatIndexCelsius(){
-	// read in raw data, and check for failure
-	if (!readSensorData()) {
-		return NAN;
+int16_t DHTFrame::getTemperatureTenthsC() const {
+	if (!isChecksumValid()) {
+		return DHT_INVALID_TENTHS;
 	}
-	return DHT_TempHumidUtils::computeHeatIndexCelsius(getTemperatureCelsius(), getPercentHumidity());
+	return decodeTemperatureTenths(type, data);
 }
 
+int16_t DHTFrame::getHumidityTenths() const {
+	if (!isChecksumValid()) {
+		return DHT_INVALID_TENTHS;
+	}
+	return decodeHumidityTenths(type, data);
+}
 
-boolean DHT::prepareRead() {
-	int16_t digitalReadCycles;
+/* static */ uint32_t DHTFrame::decodeBatch(const DHTFrame *frames, uint32_t count, int16_t *temperatureTenthsC, int16_t *humidityTenths) {
+	uint32_t frameIndex, numValid;
+	int16_t mask;
+
+	// no branches on the data here either, so the loop runs at the same
+	// speed however the frames are mixed, and the compiler is free to
+	// vectorize it; mask is all bits set for a frame that passes its
+	// checksum, and 0 otherwise
+	numValid = 0;
+	for (frameIndex = 0; frameIndex < count; frameIndex++) {
+		const uint8_t *data = frames[frameIndex].data;
+		mask = -(int16_t)checksumMatches(data);
+		temperatureTenthsC[frameIndex] = (decodeTemperatureTenths(frames[frameIndex].type, data) & mask) | (DHT_INVALID_TENTHS & ~mask);
+		humidityTenths[frameIndex] = (decodeHumidityTenths(frames[frameIndex].type, data) & mask) | (DHT_INVALID_TENTHS & ~mask);
+		numValid -= mask;
+	}
+	return numValid;
+}
 
-	// record current time
-	lastReadTime_ = millis();
 
-	// blank out the buffer
-	data_[0] = data_[1] = data_[2] = data_[3] = data_[4] = 0;
-	
-	// set flag to show we haven't gotten valid data from this read
-	validData_ = false;
+// bits of DHTReading::computed_
+#define DHT_READING_TEMPERATURE_F    0x01
+#define DHT_READING_HEAT_INDEX_F     0x02
+#define DHT_READING_HEAT_INDEX_C     0x04
+#define DHT_READING_DEW_POINT_C      0x08
+#define DHT_READING_TEMPERATURE_F10  0x10
+#define DHT_READING_HEAT_INDEX_F10   0x20
+#define DHT_READING_HEAT_INDEX_C10   0x40
+
+DHTReading::DHTReading() {
+	// a generation that no sensor will have before its first good read, so
+	// the first readAll() always fills this in
+	generation_ = 0xFFFF;
+	valid_ = false;
+	computed_ = 0;
+	temperatureTenthsC_ = DHT_INVALID_TENTHS;
+	humidityTenths_ = DHT_INVALID_TENTHS;
+	temperatureCelsius_ = NAN;
+	percentHumidity_ = NAN;
+}
 
-	// pull the pin high and wait for the sensor to chill out
-	// the original library had a delay of 250 milliseconds here, but nothing
-	// in the datasheets or elsewhere seem to indicate that's necessary, so
-	digitalWrite(pin_, HIGH);
-	delay(firstReading_ ? DHT_FIRST_START_DELAY : DHT_LATER_START_DELAYS);
+boolean DHTReading::isValid() const {
+	return valid_;
+}
 
-	// now pull it low for ~20 milliseconds as the start signal
-	pinMode(pin_, OUTPUT);
-	digitalWrite(pin_, LOW);
-	delay(20);
+uint16_t DHTReading::getGeneration() const {
+	return generation_;
+}
 
-	// turn off interrupts before continuing further
-	noInterrupts();
+float DHTReading::getTemperatureCelsius() const {
+	return temperatureCelsius_;
+}
 
-	// then pull it high for ~40 microseconds
-	digitalWrite(pin_, HIGH);
-	delayMicroseconds(40);
+float DHTReading::getPercentHumidity() const {
+	return percentHumidity_;
+}
 
-	// now we're ready to read the response signal before the data
-	pinMode(pin_, INPUT);
+int16_t DHTReading::getTemperatureTenthsC() const {
+	return temperatureTenthsC_;
+}
 
-	// first watch for the sensor to transition away from HIGH
-	if (timeSignalLength(HIGH) == -1) {
-		// we've failed to initialize properly
-		return false;
+int16_t DHTReading::getHumidityTenths() const {
+	return humidityTenths_;
+}
+
+// each of these computes its value the same way as the matching DHT
+// function, the first time it's called for a given set of data
+float DHTReading::getTemperatureFahrenheit() {
+	if (!(computed_ & DHT_READING_TEMPERATURE_F)) {
+		temperatureFahrenheit_ = DHT_TempHumidUtils::convertCelsiusToFahrenheit(temperatureCelsius_);
+		computed_ |= DHT_READING_TEMPERATURE_F;
 	}
+	return temperatureFahrenheit_;
+}
 
-	// the sensor will keep the pin LOW for ~80 microseconds
-	if (timeSignalLength(LOW) == -1) {
-		// we've failed to initialize properly
-		return false;
+float DHTReading::getHeatIndexFahrenheit() {
+	if (!valid_) {
+		return NAN;
+	}
+	if (!(computed_ & DHT_READING_HEAT_INDEX_F)) {
+		heatIndexFahrenheit_ = DHT_TempHumidUtils::computeHeatIndexFahrenheit(getTemperatureFahrenheit(), percentHumidity_);
+		computed_ |= DHT_READING_HEAT_INDEX_F;
 	}
+	return heatIndexFahrenheit_;
+}
 
-	// then it will bring the pin HIGH for another ~80 microseconds
-	if (timeSignalLength(HIGH) == -1) {
-		// we've failed to initialize properly
-		return false;
+float DHTReading::getHeatIndexCelsius() {
+	if (!valid_) {
+		return NAN;
+	}
+	if (!(computed_ & DHT_READING_HEAT_INDEX_C)) {
+		heatIndexCelsius_ = DHT_TempHumidUtils::computeHeatIndexCelsius(temperatureCelsius_, percentHumidity_);
+		computed_ |= DHT_READING_HEAT_INDEX_C;
 	}
+	return heatIndexCelsius_;
+}
 
-	// we're done preparing, the next LOW-HIGH cycle will be a real bit
-	return true;
+float DHTReading::getDewPointCelsius() {
+	if (!valid_) {
+		return NAN;
+	}
+	if (!(computed_ & DHT_READING_DEW_POINT_C)) {
+		dewPointCelsius_ = DHT_TempHumidUtils::computeDewPointCelsius(temperatureCelsius_, percentHumidity_);
+		computed_ |= DHT_READING_DEW_POINT_C;
+	}
+	return dewPointCelsius_;
 }
 
-int16_t DHT::timeSignalLength(uint8_t signalState) {
-	unsigned long startTimeMicros = micros();
+int16_t DHTReading::getTemperatureTenthsF() {
+	if (!(computed_ & DHT_READING_TEMPERATURE_F10)) {
+		temperatureTenthsF_ = DHT_TempHumidUtils::convertTenthsCelsiusToTenthsFahrenheit(temperatureTenthsC_);
+		computed_ |= DHT_READING_TEMPERATURE_F10;
+	}
+	return temperatureTenthsF_;
+}
 
-	while (digitalRead(pin_) == signalState) {
-		// watch how long we've been waiting
-		// because these are unsigned values, this works even for rollovers
-		if (micros() - startTimeMicros > 200) {
-			// there is a problem; the sensor should never leave us hanging
-			// for more than 80 microseconds, and even on devices with a
-			// micros() resolution of 8 microseconds, that means we shouldn't
-			// see an apparent delay of longer than 96 microseconds... but
-			// we'll cut it some slack and wait for up to 200 microseconds
-			return -1;
-		}
-		delayMicroseconds(1);
+int16_t DHTReading::getHeatIndexTenthsF() {
+	if (!valid_) {
+		return DHT_INVALID_TENTHS;
 	}
+	if (!(computed_ & DHT_READING_HEAT_INDEX_F10)) {
+		heatIndexTenthsF_ = DHT_TempHumidUtils::computeHeatIndexTenthsFahrenheit(getTemperatureTenthsF(), humidityTenths_);
+		computed_ |= DHT_READING_HEAT_INDEX_F10;
+	}
+	return heatIndexTenthsF_;
+}
 
-	// get the final observed wait
-	// because these are unsigned values, this works even for rollovers
-	return (uint16_t)(micros() - startTimeMicros);
+int16_t DHTReading::getHeatIndexTenthsC() {
+	if (!valid_) {
+		return DHT_INVALID_TENTHS;
+	}
+	if (!(computed_ & DHT_READING_HEAT_INDEX_C10)) {
+		heatIndexTenthsC_ = DHT_TempHumidUtils::computeHeatIndexTenthsCelsius(temperatureTenthsC_, humidityTenths_);
+		computed_ |= DHT_READING_HEAT_INDEX_C10;
+	}
+	return heatIndexTenthsC_;
+}
+
+
+#if DHT_ENABLE_STATS
+
+const DHTStats& DHTCore::getStats() {
+	return stats_;
 }
 
-int8_t DHT::readBit() {
-	int16_t signalLength;
+void DHTCore::resetStats() {
+	memset(&stats_, 0, sizeof(stats_));
+	stats_.worstMarginMicros = 0xFF;
+}
 
-	// first, we should get a LOW signal for ~50 microseconds
-	signalLength = timeSignalLength(LOW);
-	if (signalLength == -1) {
-		// we never saw the end of the signal, oops
-		return -1;
+void DHTCore::recordFallback() {
+	// valid data from a read that didn't succeed can only be the last good
+	// data standing in for it
+	if (validData_ && readStatus_ != DHT_READ_OK) {
+		incrementStat(stats_.fallbacks);
 	}
+}
 
-	// then, we should get a HIGH signal for:
-	//     ~26-28 microseconds for a "0" bit
-	//     ~70 microseconds for a "1" bit
-	signalLength = timeSignalLength(HIGH);
-	if (signalLength == -1) {
-		// we never saw the end of the signal, oops
-		return -1;
+void DHTCore::recordStats(uint8_t status) {
+	uint8_t pulseIndex, threshold, width, margin, bin;
+
+	incrementStat(stats_.attempts);
+
+	switch (status) {
+		case DHT_READ_OK:
+			incrementStat(stats_.goodReads);
+			if (corrected_) {
+				incrementStat(stats_.correctedReads);
+			}
+			break;
+		case DHT_READ_CHECKSUM_ERROR:
+			incrementStat(stats_.checksumErrors);
+			break;
+		case DHT_READ_TIMEOUT:
+		case DHT_READ_DISCONNECTED:
+			// the capture marks a sensor that never responded with a 0 in
+			// place of its first signal; see getPulseWidths()
+			if (numPulses_ == 0 && pulses_[0] == 0) {
+				incrementStat(stats_.timeouts[DHT_STATS_TIMEOUT_NO_RESPONSE]);
+			} else if (numPulses_ == 0) {
+				incrementStat(stats_.timeouts[DHT_STATS_TIMEOUT_RESPONSE_LOW]);
+			} else if (numPulses_ == 1) {
+				incrementStat(stats_.timeouts[DHT_STATS_TIMEOUT_RESPONSE_HIGH]);
+			} else {
+				incrementStat(stats_.timeouts[DHT_STATS_TIMEOUT_DATA]);
+			}
+			return;
 	}
 
-	// we'll count < 50 microseconds as a "0", and everything else as a "1"
-	return (signalLength < 50)? 0 : 1;
+	// every bit of a full read goes into the histograms, whether or not the
+	// checksum matched; a bad checksum with a small margin points at timing
+	// trouble, while one with a comfortable margin points at noise
+	threshold = computeBitThreshold(pulses_);
+	for (pulseIndex = 3; pulseIndex < DHT_NUM_PULSES; pulseIndex += 2) {
+		width = pulses_[pulseIndex];
+		if (width < threshold) {
+			margin = threshold - width;
+			bin = width / DHT_STATS_HISTOGRAM_MICROS;
+			incrementStat(stats_.zeroBitHistogram[(bin < DHT_STATS_HISTOGRAM_BINS) ? bin : DHT_STATS_HISTOGRAM_BINS-1]);
+		} else {
+			margin = width - threshold;
+			bin = margin / DHT_STATS_HISTOGRAM_MICROS;
+			incrementStat(stats_.oneBitHistogram[(bin < DHT_STATS_HISTOGRAM_BINS) ? bin : DHT_STATS_HISTOGRAM_BINS-1]);
+		}
+		if (margin < stats_.worstMarginMicros) {
+			stats_.worstMarginMicros = margin;
+		}
+	}
 }
+
+#endif
@@ -7,6 +7,7 @@
 #endif
 
 #include "limits.h"
+#include "string.h"
 #include "DHT_TempHumidUtils.h"
 
 /***************************************************************************
@@ -35,17 +36,729 @@
 // milliseconds to wait on HIGH before sending the start signal the other times
 #define DHT_LATER_START_DELAYS 20
 
+// milliseconds to hold the line LOW as the start signal
+#define DHT_START_SIGNAL_MILLIS 20
+
 // how much data we want to read
 #define DHT_NUM_BYTES 5
 
-class DHT {
+// how many signal lengths we capture while reading: the ~80 microsecond LOW
+// and HIGH response signals, then a LOW and a HIGH signal for each bit
+#define DHT_NUM_PULSES (2 + DHT_NUM_BYTES*8*2)
+
+// HIGH signals shorter than this many microseconds are "0" bits, and the
+// rest are "1" bits, when everything runs at its nominal speed
+#define DHT_BIT_THRESHOLD_MICROS 50
+
+// decodePulses() normally scales the threshold to the timing of each read
+// (see computeBitThreshold()); set this to 0 to always use
+// DHT_BIT_THRESHOLD_MICROS as-is
+#ifndef DHT_ADAPTIVE_THRESHOLD
+#define DHT_ADAPTIVE_THRESHOLD 1
+#endif
+
+// when a read fails its checksum, decodeCapture() tries flipping up to this
+// many of the bits that came closest to the threshold (0 turns this off, and
+// the most it will try is 2); see correctBits()
+#ifndef DHT_ERROR_CORRECTION_BITS
+#define DHT_ERROR_CORRECTION_BITS 2
+#endif
+
+// the nominal total length of the signals computeBitThreshold() measures:
+// the ~80 microsecond response HIGH, and the ~50 microsecond LOW before
+// each bit
+#define DHT_TIMING_REFERENCE_MICROS (80 + DHT_NUM_BYTES*8*50)
+
+// status values returned by poll()
+#define DHT_READ_IN_PROGRESS    0
+#define DHT_READ_OK             1
+#define DHT_READ_NOT_STARTED    2
+#define DHT_READ_TIMEOUT        3
+#define DHT_READ_CHECKSUM_ERROR 4
+#define DHT_READ_DISCONNECTED   5
+
+// after this many reads in a row without any response at all, a sensor is
+// considered disconnected; see isDisconnected()
+#define DHT_DISCONNECT_THRESHOLD 3
+
+// while a sensor is disconnected, the wait between reads doubles with each
+// further failure, up to 2^DHT_MAX_BACKOFF_SHIFT times the usual wait
+#define DHT_MAX_BACKOFF_SHIFT 5
+
+// milliseconds to hold the start signal when probing a disconnected sensor,
+// which is enough for a DHT21/22 (they need at least 1); the DHT11 needs at
+// least 18, so it always gets DHT_START_SIGNAL_MILLIS
+#define DHT_PROBE_SIGNAL_MILLIS 2
+
+// roughly how many microseconds the blocking part of a read (see poll())
+// takes when the sensor's timing is nominal, and the most it can take:
+// a sensor can leave each signal hanging for nearly 200 microseconds
+// before we give up on it
+#define DHT_BURST_MICROS     5500
+#define DHT_MAX_BURST_MICROS (40 + 200 + DHT_NUM_PULSES*200)
+
+// the phases of a read, as tracked internally by startRead() and poll()
+#define DHT_PHASE_IDLE         0
+#define DHT_PHASE_START_DELAY  1
+#define DHT_PHASE_START_SIGNAL 2
+#define DHT_PHASE_EXTERNAL     3   // a DHTArray is reading the sensor
+
+// set DHT_ENABLE_STATS to 1 (here, or with a compiler flag) to have each DHT
+// object keep statistics about its reads, for tracking down flaky sensors
+// and wiring; when it's 0, none of that code or memory exists at all
+#ifndef DHT_ENABLE_STATS
+#define DHT_ENABLE_STATS 0
+#endif
+
+// set DHT_ENABLE_SNAPSHOT to 1 (here, or with a compiler flag) to have each
+// DHT object publish the outcome of every read for getSnapshot(); when it's
+// 0, the DHTSnapshotSlot, which takes a couple of dozen bytes of RAM per
+// object, doesn't exist at all
+#ifndef DHT_ENABLE_SNAPSHOT
+#define DHT_ENABLE_SNAPSHOT 0
+#endif
+
+#if DHT_ENABLE_STATS
+
+// the points at which a read can time out, which index DHTStats::timeouts:
+// the sensor never answering the start signal, each half of its response
+// signal, and the data bits
+#define DHT_STATS_TIMEOUT_NO_RESPONSE   0
+#define DHT_STATS_TIMEOUT_RESPONSE_LOW  1
+#define DHT_STATS_TIMEOUT_RESPONSE_HIGH 2
+#define DHT_STATS_TIMEOUT_DATA          3
+#define DHT_STATS_NUM_TIMEOUT_PHASES    4
+
+// the bit width histograms have this many bins, each this many microseconds
+// wide; the "0" bit bins start at 0 microseconds, the "1" bit bins start at
+// the threshold the read was decoded with (see DHT::computeBitThreshold()),
+// and the first and last bins of each also count anything shorter or longer
+#define DHT_STATS_HISTOGRAM_BINS  8
+#define DHT_STATS_HISTOGRAM_MICROS 8
+
+// all the counters stick at their maximum rather than rolling over
+struct DHTStats {
+	// reads that reached the sensor, and calls that were answered from the
+	// last reading because they came too soon after it
+	uint16_t attempts;
+	uint16_t cacheHits;
+
+	// calls refused because the sensor is disconnected; see isDisconnected()
+	uint16_t backoffSkips;
+
+	// how the reads that reached the sensor turned out; corrected reads are
+	// also counted as good ones
+	uint16_t goodReads;
+	uint16_t correctedReads;
+
+	// failed reads that were covered by the last good value, counting only
+	// the last try of a readSensorData() that retries; see
+	// DHT::setRetryPolicy()
+	uint16_t fallbacks;
+	uint16_t checksumErrors;
+	uint16_t timeouts[DHT_STATS_NUM_TIMEOUT_PHASES];
+
+	// the HIGH signal lengths of every bit received in full reads, and the
+	// closest any of them came to the threshold they were decoded with
+	uint16_t zeroBitHistogram[DHT_STATS_HISTOGRAM_BINS];
+	uint16_t oneBitHistogram[DHT_STATS_HISTOGRAM_BINS];
+	uint8_t worstMarginMicros;
+};
+
+#endif
+
+// a check of whether a data buffer could have come from a working sensor of
+// some type; see DHT::correctBits()
+typedef boolean (*DHTPlausibilityCheck)(const uint8_t *data);
+
+// DHTSensorTraits describes each type of sensor at compile time: the
+// minimum delay between readings, the width of the values it sends, and how
+// to decode those values from the data buffer into tenths of a degree
+// Celsius and tenths of a percent humidity.  DHTSensor (in DHTSensor.h)
+// uses them as its type policy (see DHTBase), so everything that depends on
+// the type of sensor is settled at compile time; DHT looks the same things
+// up at runtime, through DHTRuntimeType.
+template <uint8_t TYPE> class DHTSensorTraits;
+
+template <> class DHTSensorTraits<DHT_SENSOR_TYPE_DHT11> {
+
+	public:
+
+		static const uint16_t MIN_SAMPLE_DELAY_MILLIS = 1000;
+		static const uint8_t VALUE_BITS = 8;
+
+		static uint8_t getType() {
+			return DHT_SENSOR_TYPE_DHT11;
+		}
+
+		static uint16_t getMinSampleDelayMillis() {
+			return MIN_SAMPLE_DELAY_MILLIS;
+		}
+
+		static DHTPlausibilityCheck getPlausibilityCheck() {
+			return isPlausible;
+		}
+
+		// data is in whole degrees, and fits in a byte, convenient!
+		static int16_t decodeTemperatureTenths(const uint8_t *data) {
+			return data[2] * 10;
+		}
+
+		// data is in whole percents, and fits in a byte, convenient!
+		static uint16_t decodeHumidityTenths(const uint8_t *data) {
+			return data[4] * 10;
+		}
+
+		// whether data could have come from a working sensor: 0-100%
+		// humidity, no more than 60 degrees (well past its 50 degree
+		// maximum), and single digit fractional bytes
+		static boolean isPlausible(const uint8_t *data) {
+			return data[4] <= 100 && data[3] <= 9 && data[2] <= 60 && (data[1] & 0x7F) <= 9;
+		}
+
+};
+
+template <> class DHTSensorTraits<DHT_SENSOR_TYPE_DHT22> {
+
+	public:
+
+		static const uint16_t MIN_SAMPLE_DELAY_MILLIS = 2000;
+		static const uint8_t VALUE_BITS = 16;
+
+		static uint8_t getType() {
+			return DHT_SENSOR_TYPE_DHT22;
+		}
+
+		static uint16_t getMinSampleDelayMillis() {
+			return MIN_SAMPLE_DELAY_MILLIS;
+		}
+
+		static DHTPlausibilityCheck getPlausibilityCheck() {
+			return isPlausible;
+		}
+
+		static int16_t decodeTemperatureTenths(const uint8_t *data) {
+			int16_t magnitude, sign;
+
+			// NOTE: negative temperatures are transmitted using a "signed"
+			// integer format: the highest-order bit indicates the sign of the
+			// number (0==positive, 1==negative), and the rest of the bits
+			// have the same value as they would for the absolute value of the
+			// number in question.
+			// Example: for a 16-bit value, we would have
+			//     0x016F == 0b0000000101101111 ==  367
+			//     0x816F == 0b1000000101101111 == -367
+			// This is not how most computers store negative numbers, so we
+			// have to be careful to deal properly with these
+
+			// mask the sign bit off data[2], then shift it left 8 bits, and
+			// drop data[1] into the low-order byte
+			magnitude = ((data[2] & 0x7F) << 8) | data[1];
+
+			// now put the correct sign on the value without branching: sign
+			// is 0 for positive values and -1 (all bits set) for negative
+			// ones, and (x ^ -1) - -1 == ~x + 1 == -x
+			sign = -(int16_t)(data[2] >> 7);
+			return (magnitude ^ sign) - sign;
+		}
+
+		// shift data[4] left 8 bits, and drop data[3] into the low-order byte
+		static uint16_t decodeHumidityTenths(const uint8_t *data) {
+			return (data[4] << 8) | data[3];
+		}
+
+		// whether data could have come from a working sensor: 0-100%
+		// humidity, and -40 to 80 degrees
+		static boolean isPlausible(const uint8_t *data) {
+			int16_t temperature = decodeTemperatureTenths(data);
+			return decodeHumidityTenths(data) <= 1000 && temperature >= -400 && temperature <= 800;
+		}
+
+};
+
+// the DHT21 sends its data in the same format as the DHT22
+template <> class DHTSensorTraits<DHT_SENSOR_TYPE_DHT21> : public DHTSensorTraits<DHT_SENSOR_TYPE_DHT22> {
+
+	public:
+
+		static uint8_t getType() {
+			return DHT_SENSOR_TYPE_DHT21;
+		}
+
+};
+
+// DHTFrame is the raw result of a single read: the sensor type, and the 5
+// data bytes in the same order as the data buffer (checksum first, which is
+// the reverse of the order the sensor sends them).  It's a plain value, so
+// it can be sent over a radio or stored as-is, and decoded anywhere without
+// a DHT object; readSensorData(DHTFrame&) fills one in.
+//
+// The decoding functions handle every type of sensor without branching on
+// it (anything other than a DHT11 is decoded as a DHT21/22), and give the
+// same results as the DHT get*() functions.  decodeBatch() checks and
+// decodes whole arrays of frames, such as on a gateway collecting frames
+// from many nodes; frames that fail their checksum come out as
+// DHT_INVALID_TENTHS, and it returns how many passed.
+class DHTFrame {
+
+	public:
+
+		uint8_t type;
+		uint8_t data[DHT_NUM_BYTES];
+
+		boolean isChecksumValid() const {
+			return checksumMatches(data);
+		}
+
+		// these return NAN or DHT_INVALID_TENTHS if the checksum fails
+		float getTemperatureCelsius() const;
+		float getPercentHumidity() const;
+		int16_t getTemperatureTenthsC() const;
+		int16_t getHumidityTenths() const;
+
+		static boolean checksumMatches(const uint8_t *data) {
+			return data[0] == (uint8_t)(data[1] + data[2] + data[3] + data[4]);
+		}
+
+		static int16_t decodeTemperatureTenths(uint8_t type, const uint8_t *data) {
+			// both formats are cheap enough to decode that it's faster to do
+			// both and keep one than to branch; mask is all bits set for a
+			// DHT11, and 0 otherwise
+			int16_t mask = -(int16_t)(type == DHT_SENSOR_TYPE_DHT11);
+			return (DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::decodeTemperatureTenths(data) & mask) |
+				(DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::decodeTemperatureTenths(data) & ~mask);
+		}
+
+		static int16_t decodeHumidityTenths(uint8_t type, const uint8_t *data) {
+			int16_t mask = -(int16_t)(type == DHT_SENSOR_TYPE_DHT11);
+			return (DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::decodeHumidityTenths(data) & mask) |
+				(DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::decodeHumidityTenths(data) & ~mask);
+		}
+
+		static uint32_t decodeBatch(const DHTFrame *frames, uint32_t count, int16_t *temperatureTenthsC, int16_t *humidityTenths);
+
+};
+
+// DHTRuntimeType is the type policy (see DHTBase) for a sensor whose type
+// is only known at runtime: it offers the same functions as
+// DHTSensorTraits, but looks each answer up from the type it holds.  Just
+// like DHTFrame, it treats anything other than a DHT11 as a DHT21/22.
+class DHTRuntimeType {
 
 	public:
 
-		// constructor and initializer
-		DHT(uint8_t pin, uint8_t type);
+		DHTRuntimeType(uint8_t type) : type_(type) {}
+
+		uint8_t getType() const {
+			return type_;
+		}
+
+		// this is fixed for each type of sensor, so there's no need to store
+		// it; the static version is for code that keeps its own type
+		static uint16_t getMinSampleDelayMillis(uint8_t type) {
+			if (type == DHT_SENSOR_TYPE_DHT11) {
+				return DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::MIN_SAMPLE_DELAY_MILLIS;
+			}
+			return DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::MIN_SAMPLE_DELAY_MILLIS;
+		}
+
+		uint16_t getMinSampleDelayMillis() const {
+			return getMinSampleDelayMillis(type_);
+		}
+
+		int16_t decodeTemperatureTenths(const uint8_t *data) const {
+			return DHTFrame::decodeTemperatureTenths(type_, data);
+		}
+
+		uint16_t decodeHumidityTenths(const uint8_t *data) const {
+			return DHTFrame::decodeHumidityTenths(type_, data);
+		}
+
+		DHTPlausibilityCheck getPlausibilityCheck() const {
+			if (type_ == DHT_SENSOR_TYPE_DHT11) {
+				return DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::isPlausible;
+			}
+			return DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::isPlausible;
+		}
+
+
+	private:
+
+		uint8_t type_;
+
+};
+
+// DHTReading holds every value DHT can give for one set of data, filled in
+// by DHT::readAll().  The temperature and humidity are decoded once, when
+// the data changes; the derived values (Fahrenheit, heat index, dew point)
+// are only computed the first time they're asked for, and then kept until
+// the data changes again.  The caller owns the DHTReading, so asking for
+// everything every time through the loop costs about one decode per new
+// read, and next to nothing in between.  The getters return the same
+// values (NAN or DHT_INVALID_TENTHS included) as the matching DHT get*()
+// and read*() functions.
+class DHTReading {
+
+	template <class Type> friend class DHTBase;
+
+	public:
+
+		DHTReading();
+
+		boolean isValid() const;
+
+		// which data this reading holds; see DHT::getGeneration()
+		uint16_t getGeneration() const;
+
+		float getTemperatureCelsius() const;
+		float getPercentHumidity() const;
+		int16_t getTemperatureTenthsC() const;
+		int16_t getHumidityTenths() const;
+
+		float getTemperatureFahrenheit();
+		float getHeatIndexFahrenheit();
+		float getHeatIndexCelsius();
+		float getDewPointCelsius();
+		int16_t getTemperatureTenthsF();
+		int16_t getHeatIndexTenthsF();
+		int16_t getHeatIndexTenthsC();
+
+
+	private:
+
+		uint16_t generation_;
+		boolean valid_;
+		int16_t temperatureTenthsC_;
+		int16_t humidityTenths_;
+		float temperatureCelsius_;
+		float percentHumidity_;
+
+		// each derived value has a bit in computed_, set once it's been
+		// computed for the current data
+		uint8_t computed_;
+		float temperatureFahrenheit_;
+		float heatIndexFahrenheit_;
+		float heatIndexCelsius_;
+		float dewPointCelsius_;
+		int16_t temperatureTenthsF_;
+		int16_t heatIndexTenthsF_;
+		int16_t heatIndexTenthsC_;
+
+};
+
+// DHTSnapshot is the outcome of a finished read, as published by
+// DHT::getSnapshot() (see DHT_ENABLE_SNAPSHOT).  It holds the frame that the
+// get*() functions decode their values from, and whether that frame is
+// valid (which it may be after a failed read, if the retry policy fell back
+// to the last good data).  It also holds when that data was read (a
+// millis() timestamp), the status of the read, and the generation of the
+// data (see DHT::getGeneration()).
+struct DHTSnapshot {
+	DHTFrame frame;
+	boolean valid;
+	uint8_t status;
+	uint16_t generation;
+	unsigned long timestamp;
+};
+
+// the sequence counter guarding a DHTSnapshotSlot; a single byte can be
+// read and written atomically on an AVR, while elsewhere a 32-bit value can
+// be (and won't roll over in the middle of a read)
+#if defined(__AVR__)
+typedef uint8_t DHTSequence;
+#else
+typedef uint32_t DHTSequence;
+#endif
+
+// DHTSnapshotSlot publishes DHTSnapshots from one writer to any number of
+// readers, which may be interrupt handlers, RTOS tasks or (on a host build)
+// other threads, without any locking.  It keeps two copies of the snapshot,
+// and the low bit of the sequence counter says which one readers should
+// use.  The writer moves the readers over to one copy while it updates the
+// other, then moves them back to update the first: neither the writer nor
+// a reader ever waits on the other.  A reader that interrupts the writer
+// always finds a copy that isn't being written, so it finishes in one pass;
+// a reader that is itself interrupted by a publish (or that runs alongside
+// one, on another core) notices that the counter has moved, and copies
+// again.  Only one context may call publish().
+class DHTSnapshotSlot {
+
+	public:
+
+		DHTSnapshotSlot() : sequence_(0) {}
+
+		void publish(const DHTSnapshot &snapshot) {
+			DHTSequence sequence = sequence_;
+
+			// the fences keep the compiler (and on multi-core hosts, the
+			// processor) from moving the copies across the counter updates
+			__atomic_store_n(&sequence_, sequence + 1, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			copies_[sequence & 1] = snapshot;
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			__atomic_store_n(&sequence_, sequence + 2, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			copies_[(sequence + 1) & 1] = snapshot;
+		}
+
+		void read(DHTSnapshot &snapshot) const {
+			DHTSequence sequence;
+
+			do {
+				sequence = __atomic_load_n(&sequence_, __ATOMIC_ACQUIRE);
+				snapshot = copies_[sequence & 1];
+				__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			} while (__atomic_load_n(&sequence_, __ATOMIC_RELAXED) != sequence);
+		}
+
+
+	private:
+
+		DHTSequence sequence_;
+		DHTSnapshot copies_[2];
+
+};
+
+// DHTCore reads its pin through one of these; the signal timing loop is
+// written as a template over the pin class, so that DHTFast (in DHTFast.h)
+// can plug in a faster way of reading a pin whose number is known at
+// compile time
+class DHTRuntimePin {
+
+	public:
+
+		DHTRuntimePin(uint8_t pin) : pin_(pin) {}
+		uint8_t read() const { return digitalRead(pin_); }
+
+	private:
+
+		uint8_t pin_;
+
+};
+
+// DHTCore is everything DHT and DHTSensor (in DHTSensor.h) have in common:
+// the pin, the buffer, the read state machine and the signal timing loop.
+// It knows nothing about the type of sensor; the few parts of a read that
+// depend on it are handed what they need by DHTBase, below.
+class DHTCore {
+
+	// DHTArray reads several sensors at once, and fills in their buffers
+	friend class DHTArray;
+	// DHTLog records the outcome of each read, straight from the buffer
+	friend class DHTLog;
+
+	public:
+
+		// initializer
 		void begin();
 
+		// setRetryPolicy() changes how hard readSensorData() (and so the
+		// read*() functions) tries before giving up.  After a failed read, it
+		// waits retrySpacingMillis (or the minimum sampling delay, if that's
+		// longer) and tries again, up to maxRetries more times.  If every try
+		// fails but the last good value is no more than maxAgeMillis old,
+		// that value is used in place of the failed read, with
+		// getValueAgeMillis() telling how old it is.  The default policy
+		// (0, 0, 0) makes a single try and never falls back.
+		//
+		// Only the fallback applies to startRead() and poll(); the caller
+		// decides when to try again there.  Keep in mind that retries block
+		// for at least the minimum sampling delay each.
+		void setRetryPolicy(uint8_t maxRetries, uint16_t retrySpacingMillis, unsigned long maxAgeMillis);
+
+		// when the data the get*() functions return was read (as a millis()
+		// timestamp of the end of that read), and how long ago that was;
+		// these are only meaningful while the get*() functions return valid
+		// values
+		unsigned long getValueTimestamp();
+		unsigned long getValueAgeMillis();
+
+		// these, along with isReadDue() and cancelRead(), let a caller (such
+		// as DHTScheduler) plan around the blocking part of a read.
+		// isReadDue() says whether startRead() would start a new read right
+		// now, isReadInProgress() whether one has started but not finished,
+		// and isBurstDue() whether the next call to poll() will be the one
+		// that blocks.  Holding off on that call just stretches the start
+		// signal; if it's held off for too long, cancelRead() gives up on
+		// the read, releasing the line, and the sample window it used is
+		// lost.  After cancelRead(), poll() returns DHT_READ_NOT_STARTED, and
+		// the get*() functions return the last good values if the retry
+		// policy allows it, just as for a failed read.
+		boolean isReadInProgress();
+		boolean isBurstDue();
+
+		// a sensor that hasn't answered DHT_DISCONNECT_THRESHOLD start
+		// signals in a row is probably unplugged or dead, so rather than
+		// spend ~40 milliseconds on every read, reads of it are refused
+		// (returning DHT_READ_DISCONNECTED from poll()) for longer and
+		// longer stretches.  When a stretch is over, the next read is a
+		// probe: no start delay, and a short start signal.  If the sensor
+		// answers, the probe doubles as a normal read, and the sensor is
+		// connected again.
+		boolean isDisconnected();
+
+		// while the sensor is sending data, we only record the length of
+		// each signal; the bits are decoded after interrupts are turned back
+		// on.  getPulseWidths() gives access to those raw signal lengths (in
+		// microseconds) from the most recent read, which can be useful for
+		// diagnostics, and getNumPulses() says how many of them were actually
+		// captured (fewer than DHT_NUM_PULSES means the read timed out).  The
+		// signal that timed out is recorded as 255, unless the sensor never
+		// responded at all, in which case the first signal is recorded as 0.
+		const uint8_t* getPulseWidths();
+		uint8_t getNumPulses();
+
+		// decodePulses() turns DHT_NUM_PULSES captured signal lengths into
+		// DHT_NUM_BYTES bytes of data, and returns whether the checksum
+		// matches
+		static boolean decodePulses(const uint8_t *pulses, uint8_t *data);
+
+		// computeBitThreshold() gives the 0/1 threshold decodePulses() uses
+		// for a set of captured signals.  A sensor's clock can run fast or
+		// slow (as can micros(), on some boards), which stretches or squeezes
+		// all of its signals alike; the signals whose lengths don't depend on
+		// the data tell us by how much, so the threshold is scaled to match.
+		// If the result is implausible, DHT_BIT_THRESHOLD_MICROS is used.
+		static uint8_t computeBitThreshold(const uint8_t *pulses);
+
+		// correctBits() tries to recover data that failed its checksum.  The
+		// bits whose HIGH signals came closest to the threshold are the
+		// least reliable, so it flips the weakest one, then (if
+		// DHT_ERROR_CORRECTION_BITS allows) pairs of the weakest few, and
+		// keeps the first result that passes the checksum and that
+		// isPlausible says a sensor could have sent.  Bits that were decoded
+		// with a comfortable margin are never flipped.  It returns whether
+		// data was corrected; if not, data is left as it was.
+		static boolean correctBits(const uint8_t *pulses, uint8_t *data, boolean (*isPlausible)(const uint8_t *data));
+
+		// whether the data from the most recent read only passed its checksum
+		// after correctBits() fixed it up
+		boolean wasCorrected();
+
+		// a counter that goes up every time a read brings in new data, which
+		// is how readAll() tells whether a DHTReading is already up to date
+		uint16_t getGeneration();
+
+#if DHT_ENABLE_SNAPSHOT
+		// the outcome of the most recent finished read; see DHTSnapshot.
+		// Unlike the other functions here, this is safe to call from an
+		// interrupt handler (or another task or thread) at any time, even in
+		// the middle of a read: it never sees the buffer half-written, and
+		// never waits.  It returns whether the snapshot holds valid data.
+		boolean getSnapshot(DHTSnapshot &snapshot);
+#endif
+
+#if DHT_ENABLE_STATS
+		// statistics on every read since construction or the last reset
+		const DHTStats& getStats();
+		void resetStats();
+#endif
+
+
+	protected:
+
+		uint8_t pin_;
+		uint8_t data_[6];
+		boolean validData_;
+		uint8_t readStatus_;
+
+		DHTCore(uint8_t pin);
+
+		// the parts of a read that depend on the type of sensor, which
+		// DHTBase calls with what its type policy says
+		boolean isReadDue(uint16_t minSampleDelayMillis);
+		boolean startRead(uint8_t type, uint16_t minSampleDelayMillis);
+		void cancelRead(uint8_t type);
+		boolean waitToRetry(uint8_t attempt, uint16_t minSampleDelayMillis);
+		void finishRead(uint8_t numPulses, uint8_t type, DHTPlausibilityCheck isPlausible, boolean countFallback);
+		void finishExternalRead(uint8_t type, DHTPlausibilityCheck isPlausible);
+
+		// advanceRead() moves a read along up to its burst, and returns
+		// whether it's time for the burst; capturePulsesWith() then sends the
+		// end of the start signal and records the sensor's signal lengths
+		// into the buffer, leaving interrupts off, and returns the number of
+		// signals captured.  The timing loop reads the pin through the Pin
+		// class (see DHTRuntimePin)
+		boolean advanceRead();
+		template <class Pin> uint8_t capturePulsesWith(const Pin &pin);
+		template <class Pin> int16_t timeSignalLength(const Pin &pin, uint8_t signalState);
+
+#if DHT_ENABLE_SNAPSHOT
+		void publishSnapshot(uint8_t status, uint8_t type);
+#endif
+
+
+	private:
+
+		uint8_t pulses_[DHT_NUM_PULSES];
+		uint8_t numPulses_;
+		unsigned long lastReadTime_;
+		boolean firstReading_;
+
+		uint8_t maxRetries_;
+		uint16_t retrySpacingMillis_;
+		unsigned long maxAgeMillis_;
+		boolean haveGoodData_;
+		unsigned long lastGoodTime_;
+
+		uint8_t readPhase_;
+		uint8_t startDelayMillis_;
+		uint8_t startSignalMillis_;
+		unsigned long phaseStartTime_;
+		uint8_t noResponseCount_;
+
+		boolean corrected_;
+		uint16_t generation_;
+
+		unsigned long getSampleWindowMillis(uint16_t minSampleDelayMillis);
+		uint8_t decodeCapture(uint8_t type, DHTPlausibilityCheck isPlausible);
+		boolean useLastGoodData();
+
+		// a DHTArray drives the start signal and the burst itself; this does
+		// the rest of what startRead() would, so the sensor's own state
+		// agrees with the array's
+		void beginExternalRead(unsigned long startTime);
+
+#if DHT_ENABLE_STATS
+		DHTStats stats_;
+		void recordStats(uint8_t status);
+
+		// counts a fallback, if the read that just finished made one; a
+		// readSensorData() that retries only counts its last try's
+		void recordFallback();
+#endif
+
+#if DHT_ENABLE_SNAPSHOT
+		DHTSnapshotSlot snapshot_;
+#endif
+
+};
+
+// DHTBase adds everything that depends on the type of sensor to DHTCore.
+// It looks all of that up through its type policy: DHT uses DHTRuntimeType,
+// which checks the type it was given at runtime, while DHTSensor uses
+// DHTSensorTraits, so that its decoding, sample window and error correction
+// are all resolved at compile time.  The policy is a base class rather than
+// a member so that DHTSensorTraits, which has no data, takes up no room.
+template <class Type>
+class DHTBase : public DHTCore, protected Type {
+
+	// DHTArray finishes its sensors' reads for them
+	friend class DHTArray;
+
+	public:
+
+		DHTBase(uint8_t pin, const Type &type) : DHTCore(pin), Type(type) {
+#if DHT_ENABLE_SNAPSHOT
+			publishSnapshot(DHT_READ_NOT_STARTED, Type::getType());
+#endif
+		}
+
+		// the type of sensor, one of the DHT_SENSOR_TYPE_* values
+		uint8_t getType() {
+			return Type::getType();
+		}
+
 		// readSensorData() does the actual magic of reading data from the
 		// sensor and storing them in the buffer, returning a flag indicating
 		// whether the data in the buffer is valid.  If readSensorData() is
@@ -56,7 +769,53 @@ class DHT {
 		// If you want to have full control over what happens when, you will
 		// want to use this function and the get*() functions; otherwise, you
 		// can just use the convenience read*() functions.
-		boolean readSensorData();
+		boolean readSensorData() {
+			return readSensorDataWith(DHTRuntimePin(pin_));
+		}
+
+		// the same, but also hands back the raw frame the get*() functions
+		// decode their values from; the frame is only meaningful when this
+		// returns true
+		boolean readSensorData(DHTFrame &frame) {
+			return fillFrame(frame, readSensorData());
+		}
+
+		// the minimum number of milliseconds between reads for this type of
+		// sensor
+		uint16_t getMinSampleDelayMillis() {
+			return Type::getMinSampleDelayMillis();
+		}
+
+		// startRead() and poll() are a non-blocking alternative to
+		// readSensorData().  startRead() kicks off a read (subject to the
+		// same minimum sampling delay as readSensorData()), and returns true
+		// if a read is now in progress.  poll() should then be called
+		// frequently from the main loop; it moves the read along by checking
+		// the clock rather than calling delay(), and returns
+		// DHT_READ_IN_PROGRESS until the read is finished, after which it
+		// returns the status of the most recent read.  The only time poll()
+		// blocks is for the ~5 millisecond burst in which the sensor sends
+		// its data bits, and that burst is also the only time interrupts are
+		// turned off.  The start signal only ends when poll() gets around to
+		// ending it, so a late call just stretches it: the sensor always gets
+		// at least DHT_START_SIGNAL_MILLIS of it (or DHT_PROBE_SIGNAL_MILLIS,
+		// when probing a disconnected sensor; see isDisconnected()).
+		boolean startRead() {
+			return DHTCore::startRead(Type::getType(), Type::getMinSampleDelayMillis());
+		}
+
+		uint8_t poll() {
+			return pollWith(DHTRuntimePin(pin_));
+		}
+
+		// see isReadInProgress()
+		boolean isReadDue() {
+			return DHTCore::isReadDue(Type::getMinSampleDelayMillis());
+		}
+
+		void cancelRead() {
+			DHTCore::cancelRead(Type::getType());
+		}
 
 		// the get*() functions read the data from the buffer, and in the case
 		// of getTemperatureFahrenheit(), converts the value from Celsius.  If
@@ -78,15 +837,69 @@ class DHT {
 		//     DHT21: +/- 3% to 5%
 		//     DHT22: +/- 2% to 5%
 		//
-		float getTemperatureCelsius();
-		float getTemperatureFahrenheit();
-		float getPercentHumidity();
+		float getTemperatureCelsius() {
+			if (!validData_) {
+				return NAN;
+			}
+			// the decoded value is in tenths of degrees, so scale the result
+			return Type::decodeTemperatureTenths(data_)/10.0;
+		}
+
+		float getTemperatureFahrenheit() {
+			return DHT_TempHumidUtils::convertCelsiusToFahrenheit(getTemperatureCelsius());
+		}
+
+		float getPercentHumidity() {
+			if (!validData_) {
+				return NAN;
+			}
+			// the decoded value is in tenths of a percent, so scale the result
+			return Type::decodeHumidityTenths(data_)/10.0;
+		}
+
+		// integer versions of the get*() functions, which avoid floating
+		// point math entirely: temperatures are in tenths of a degree, and
+		// humidity is in tenths of a percent (so 21.6C is 216).  Instead of
+		// NAN, these return DHT_INVALID_TENTHS when there's no valid data.
+		int16_t getTemperatureTenthsC() {
+			if (!validData_) {
+				return DHT_INVALID_TENTHS;
+			}
+			return Type::decodeTemperatureTenths(data_);
+		}
+
+		int16_t getTemperatureTenthsF() {
+			return DHT_TempHumidUtils::convertTenthsCelsiusToTenthsFahrenheit(getTemperatureTenthsC());
+		}
+
+		int16_t getHumidityTenths() {
+			if (!validData_) {
+				return DHT_INVALID_TENTHS;
+			}
+			return Type::decodeHumidityTenths(data_);
+		}
 
 		// the read*() functions are convenience functions that encapsulate a
 		// readSensorData() call followed by any get*() and conversions needed
-		float readTemperatureCelsius();
-		float readTemperatureFahrenheit();
-		float readPercentHumidity();
+		float readTemperatureCelsius() {
+			// read in raw data, and check for failure
+			if (!readSensorData()) {
+				return NAN;
+			}
+			return getTemperatureCelsius();
+		}
+
+		float readTemperatureFahrenheit() {
+			return DHT_TempHumidUtils::convertCelsiusToFahrenheit(readTemperatureCelsius());
+		}
+
+		float readPercentHumidity() {
+			// read in raw data, and check for failure
+			if (!readSensorData()) {
+				return NAN;
+			}
+			return getPercentHumidity();
+		}
 
 		// note that there are no corresponding getHeatIndex*() functions;
 		// this is because the heat index is a derived value, and is not
@@ -97,24 +910,203 @@ class DHT {
 		// temperature and percentHumidity values will be compounded when
 		// passed through the heat index calculation, so the overall error
 		// bounds is larger than any of the individual error bounds
-		float readHeatIndexCelsius();
-		float readHeatIndexFahrenheit();
+		float readHeatIndexCelsius() {
+			// read in raw data, and check for failure
+			if (!readSensorData()) {
+				return NAN;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexCelsius(getTemperatureCelsius(), getPercentHumidity());
+		}
+
+		float readHeatIndexFahrenheit() {
+			// read in raw data, and check for failure
+			if (!readSensorData()) {
+				return NAN;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexFahrenheit(getTemperatureFahrenheit(), getPercentHumidity());
+		}
+
+		// integer versions of the above, in tenths of a degree; see
+		// DHT_TempHumidUtils.h for how these compare to the float versions
+		int16_t readHeatIndexTenthsC() {
+			// read in raw data, and check for failure
+			if (!readSensorData()) {
+				return DHT_INVALID_TENTHS;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexTenthsCelsius(getTemperatureTenthsC(), getHumidityTenths());
+		}
+
+		int16_t readHeatIndexTenthsF() {
+			// read in raw data, and check for failure
+			if (!readSensorData()) {
+				return DHT_INVALID_TENTHS;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexTenthsFahrenheit(getTemperatureTenthsF(), getHumidityTenths());
+		}
+
+		// readAll() does a readSensorData(), and brings reading up to date
+		// with the result; see DHTReading.  It returns whether the reading
+		// holds valid data.
+		boolean readAll(DHTReading &reading) {
+			readSensorData();
+			return updateReading(reading);
+		}
+
+
+	protected:
+
+		// readSensorData() and poll(), as templates over the pin class that
+		// the timing loop reads; DHTBase runs them with DHTRuntimePin, and
+		// DHTFast with its own pin policy, so the choice is made at compile
+		// time
+		template <class Pin> boolean readSensorDataWith(const Pin &pin);
+		template <class Pin> uint8_t pollWith(const Pin &pin, boolean countFallback = true);
+
+		// the parts of readSensorData(DHTFrame&) and readAll() that come
+		// after the read, so DHTFast can reuse them
+		boolean fillFrame(DHTFrame &frame, boolean valid) {
+			frame.type = Type::getType();
+			memcpy(frame.data, data_, DHT_NUM_BYTES);
+			return valid;
+		}
+
+		boolean updateReading(DHTReading &reading);
 
 
 	private:
 
-		uint8_t pin_, type_;
+		void finishExternalRead() {
+			DHTCore::finishExternalRead(Type::getType(), Type::getPlausibilityCheck());
+		}
 
-		uint16_t minSampleDelayMillis_;
-		uint8_t data_[6];
-		unsigned long lastReadTime_;
-		boolean firstReading_;
-		boolean validData_;
+};
 
-		boolean prepareRead();
-		int16_t timeSignalLength(uint8_t signalState);
-		int8_t readBit();
+// DHT is the sensor class for a type of sensor given at runtime, which is
+// all most sketches need; see DHTBase and DHTCore for what it can do, and
+// DHTSensor (in DHTSensor.h) for a sensor whose type is fixed at compile
+// time
+class DHT : public DHTBase<DHTRuntimeType> {
+
+	public:
+
+		// constructor; type is one of the DHT_SENSOR_TYPE_* values
+		DHT(uint8_t pin, uint8_t type) : DHTBase<DHTRuntimeType>(pin, DHTRuntimeType(type)) {}
 
 };
 
+
+template <class Type> boolean DHTBase<Type>::updateReading(DHTReading &reading) {
+	// the data only changes when the generation does, but validData_ can
+	// change without it (a failed read, or a fallback to the last good data)
+	if (reading.generation_ == getGeneration() && reading.valid_ == validData_) {
+		return validData_;
+	}
+
+	reading.generation_ = getGeneration();
+	reading.valid_ = validData_;
+	reading.computed_ = 0;
+	reading.temperatureTenthsC_ = getTemperatureTenthsC();
+	reading.humidityTenths_ = getHumidityTenths();
+	if (reading.temperatureTenthsC_ == DHT_INVALID_TENTHS || reading.humidityTenths_ == DHT_INVALID_TENTHS) {
+		reading.valid_ = false;
+		reading.temperatureCelsius_ = NAN;
+		reading.percentHumidity_ = NAN;
+	} else {
+		// the same scaling getTemperatureCelsius() and getPercentHumidity() use
+		reading.temperatureCelsius_ = reading.temperatureTenthsC_/10.0;
+		reading.percentHumidity_ = reading.humidityTenths_/10.0;
+	}
+	return reading.valid_;
+}
+
+template <class Type> template <class Pin> boolean DHTBase<Type>::readSensorDataWith(const Pin &pin) {
+	uint8_t attempt;
+
+	// this is just a blocking wrapper around startRead() and poll(), plus
+	// any retries the policy calls for
+	for (attempt = 0; startRead(); attempt++) {
+		// waitToRetry() counts the fallback, if any, once there are no more
+		// tries to make
+		while (pollWith(pin, false) == DHT_READ_IN_PROGRESS) {
+			// keep waiting
+		}
+		if (!waitToRetry(attempt, Type::getMinSampleDelayMillis())) {
+			break;
+		}
+	}
+	return validData_;
+}
+
+template <class Type> template <class Pin> uint8_t DHTBase<Type>::pollWith(const Pin &pin, boolean countFallback) {
+	// advanceRead() takes care of everything up to the burst, which is the
+	// only part of the read that blocks
+	if (advanceRead()) {
+		finishRead(capturePulsesWith(pin), Type::getType(), Type::getPlausibilityCheck(), countFallback);
+	}
+	return readStatus_;
+}
+
+template <class Pin> uint8_t DHTCore::capturePulsesWith(const Pin &pin) {
+	int16_t signalLength;
+	uint8_t signalState;
+	uint8_t pulseIndex;
+
+	// turn off interrupts before continuing further
+	noInterrupts();
+
+	// then pull it high for ~40 microseconds
+	digitalWrite(pin_, HIGH);
+	delayMicroseconds(40);
+
+	// now we're ready to read the response signal before the data
+	pinMode(pin_, INPUT);
+
+	// first watch for the sensor to transition away from HIGH
+	if (timeSignalLength(pin, HIGH) == -1) {
+		// we've failed to initialize properly
+		pulses_[0] = 0;
+		return 0;
+	}
+
+	// the sensor will keep the pin LOW for ~80 microseconds, then HIGH for
+	// another ~80 microseconds, and after that each bit is a LOW signal
+	// followed by a HIGH signal; we keep the work done per signal to a bare
+	// minimum so we don't miss any transitions
+	signalState = LOW;
+	for (pulseIndex = 0; pulseIndex < DHT_NUM_PULSES; pulseIndex++) {
+		signalLength = timeSignalLength(pin, signalState);
+		if (signalLength == -1) {
+			// we never saw the end of the signal, oops
+			pulses_[pulseIndex] = 0xFF;
+			return pulseIndex;
+		}
+		pulses_[pulseIndex] = (signalLength > 0xFF) ? 0xFF : signalLength;
+		signalState = !signalState;
+	}
+
+	return pulseIndex;
+}
+
+template <class Pin> int16_t DHTCore::timeSignalLength(const Pin &pin, uint8_t signalState) {
+	unsigned long startTimeMicros = micros();
+
+	while (pin.read() == signalState) {
+		// watch how long we've been waiting
+		// because these are unsigned values, this works even for rollovers
+		if (micros() - startTimeMicros > 200) {
+			// there is a problem; the sensor should never leave us hanging
+			// for more than 80 microseconds, and even on devices with a
+			// micros() resolution of 8 microseconds, that means we shouldn't
+			// see an apparent delay of longer than 96 microseconds... but
+			// we'll cut it some slack and wait for up to 200 microseconds
+			return -1;
+		}
+		delayMicroseconds(1);
+	}
+
+	// get the final observed wait
+	// because these are unsigned values, this works even for rollovers
+	return (uint16_t)(micros() - startTimeMicros);
+}
+
 #endif
@@ -0,0 +1,236 @@
+/***************************************************************************
+ * Multi-sensor reader, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+#include "DHTArray.h"
+
+DHTArray::DHTArray() {
+	numSensors_ = 0;
+	minSampleDelayMillis_ = 0;
+	firstReading_ = true;
+	validMask_ = 0;
+	readPhase_ = DHT_PHASE_IDLE;
+}
+
+boolean DHTArray::add(DHT &sensor) {
+	if (numSensors_ >= DHT_ARRAY_MAX_SENSORS) {
+		return false;
+	}
+	sensors_[numSensors_++] = &sensor;
+
+	// we can't read any faster than the slowest sensor allows
+	if (sensor.getMinSampleDelayMillis() > minSampleDelayMillis_) {
+		minSampleDelayMillis_ = sensor.getMinSampleDelayMillis();
+	}
+	return true;
+}
+
+void DHTArray::begin() {
+	uint8_t i;
+
+	lastReadTime_ = 0;
+	for (i = 0; i < numSensors_; i++) {
+		sensors_[i]->begin();
+		bitMasks_[i] = 1<<i;
+	}
+
+#ifdef DHT_ARRAY_PORT_READS
+	// if every sensor is on the same port, samplePins() can just read the
+	// port's input register, and each sensor's bit mask is its pin's bit
+	inputRegister_ = NULL;
+	if (numSensors_ > 0) {
+		inputRegister_ = portInputRegister(digitalPinToPort(sensors_[0]->pin_));
+	}
+	for (i = 1; i < numSensors_; i++) {
+		if (portInputRegister(digitalPinToPort(sensors_[i]->pin_)) != inputRegister_) {
+			inputRegister_ = NULL;
+		}
+	}
+	if (inputRegister_) {
+		for (i = 0; i < numSensors_; i++) {
+			bitMasks_[i] = digitalPinToBitMask(sensors_[i]->pin_);
+		}
+	}
+#endif
+}
+
+uint8_t DHTArray::readSensorData() {
+	int16_t status;
+
+	// this is just a blocking wrapper around startRead() and poll()
+	if (!startRead()) {
+		return validMask_;
+	}
+	while ((status = poll()) == DHT_ARRAY_READ_IN_PROGRESS) {
+		// keep waiting
+	}
+	return status;
+}
+
+boolean DHTArray::startRead() {
+	uint8_t i;
+	DHT *sensor;
+
+	if (readPhase_ != DHT_PHASE_IDLE) {
+		// a read is already in flight
+		return true;
+	}
+
+	// because these are unsigned values, this works even for rollovers
+	if (!firstReading_ && ((millis() - lastReadTime_) < minSampleDelayMillis_)) {
+		// we're not going to ask the sensors for more data
+		return false;
+	}
+
+	lastReadTime_ = millis();
+	phaseStartTime_ = lastReadTime_;
+
+	// hand each sensor over to the array (see DHT::beginExternalRead()), and
+	// pull all the pins high
+	for (i = 0; i < numSensors_; i++) {
+		sensor = sensors_[i];
+		sensor->beginExternalRead(lastReadTime_);
+		digitalWrite(sensor->pin_, HIGH);
+	}
+	startDelayMillis_ = firstReading_ ? DHT_FIRST_START_DELAY : DHT_LATER_START_DELAYS;
+	firstReading_ = false;
+
+	readPhase_ = DHT_PHASE_START_DELAY;
+	return true;
+}
+
+int16_t DHTArray::poll() {
+	uint8_t i;
+	DHT *sensor;
+
+	// because these are unsigned values, the elapsed time checks below work
+	// even for rollovers
+	switch (readPhase_) {
+		case DHT_PHASE_START_DELAY:
+			if (millis() - phaseStartTime_ < startDelayMillis_) {
+				return DHT_ARRAY_READ_IN_PROGRESS;
+			}
+			// send the start signal to all the sensors at once
+			for (i = 0; i < numSensors_; i++) {
+				pinMode(sensors_[i]->pin_, OUTPUT);
+				digitalWrite(sensors_[i]->pin_, LOW);
+			}
+			phaseStartTime_ = millis();
+			readPhase_ = DHT_PHASE_START_SIGNAL;
+			return DHT_ARRAY_READ_IN_PROGRESS;
+		case DHT_PHASE_START_SIGNAL:
+			if (millis() - phaseStartTime_ < DHT_START_SIGNAL_MILLIS) {
+				return DHT_ARRAY_READ_IN_PROGRESS;
+			}
+			// this is the only part of the read that blocks
+			capturePulses();
+			readPhase_ = DHT_PHASE_IDLE;
+
+			// now decode each sensor's signals, just as it would have
+			validMask_ = 0;
+			for (i = 0; i < numSensors_; i++) {
+				sensor = sensors_[i];
+				sensor->finishExternalRead();
+				if (sensor->readStatus_ == DHT_READ_OK) {
+					validMask_ |= 1<<i;
+				}
+			}
+			break;
+	}
+	return validMask_;
+}
+
+void DHTArray::capturePulses() {
+	uint8_t signalStates[DHT_ARRAY_MAX_SENSORS];
+	unsigned long edgeTimes[DHT_ARRAY_MAX_SENSORS];
+	unsigned long now, signalLength;
+	uint8_t activeMask, waitingMask, sensorMask, sample, i;
+	DHT *sensor;
+
+	// turn off interrupts before continuing further
+	noInterrupts();
+
+	// pull all the pins high for ~40 microseconds, then get ready to read
+	// the response signals
+	for (i = 0; i < numSensors_; i++) {
+		digitalWrite(sensors_[i]->pin_, HIGH);
+	}
+	delayMicroseconds(40);
+	for (i = 0; i < numSensors_; i++) {
+		pinMode(sensors_[i]->pin_, INPUT);
+	}
+
+	// each sensor stays "active" until it has sent all its signals or timed
+	// out, and is "waiting" until it first transitions away from HIGH
+	activeMask = waitingMask = (1<<numSensors_) - 1;
+	now = micros();
+	for (i = 0; i < numSensors_; i++) {
+		signalStates[i] = HIGH;
+		edgeTimes[i] = now;
+		sensors_[i]->numPulses_ = 0;
+	}
+
+	// sample all the pins in one go, and record the length of each signal
+	// that just ended; as in DHT::capturePulsesWith(), the work done per signal
+	// is kept to a bare minimum
+	while (activeMask) {
+		sample = samplePins();
+		now = micros();
+		for (i = 0, sensorMask = 1; i < numSensors_; i++, sensorMask <<= 1) {
+			if (!(activeMask & sensorMask)) {
+				continue;
+			}
+
+			// because these are unsigned values, this works even for rollovers
+			signalLength = now - edgeTimes[i];
+			if (((sample & bitMasks_[i]) ? HIGH : LOW) == signalStates[i]) {
+				if (signalLength > 200) {
+					// this sensor is leaving us hanging; see
+					// DHT::timeSignalLength() for why 200 microseconds, and
+					// DHT::getPulseWidths() for how the stall is recorded
+					activeMask &= ~sensorMask;
+					sensor = sensors_[i];
+					sensor->pulses_[sensor->numPulses_] = (waitingMask & sensorMask) ? 0 : 0xFF;
+				}
+				continue;
+			}
+
+			sensor = sensors_[i];
+			if (waitingMask & sensorMask) {
+				// the sensor just started its response signal
+				waitingMask &= ~sensorMask;
+			} else {
+				sensor->pulses_[sensor->numPulses_++] = (signalLength > 0xFF) ? 0xFF : signalLength;
+				if (sensor->numPulses_ == DHT_NUM_PULSES) {
+					activeMask &= ~sensorMask;
+				}
+			}
+			signalStates[i] = !signalStates[i];
+			edgeTimes[i] = now;
+		}
+	}
+
+	// turn interrupts back on
+	interrupts();
+}
+
+uint8_t DHTArray::samplePins() {
+	uint8_t sample, i;
+
+#ifdef DHT_ARRAY_PORT_READS
+	if (inputRegister_) {
+		return *inputRegister_;
+	}
+#endif
+
+	sample = 0;
+	for (i = 0; i < numSensors_; i++) {
+		if (digitalRead(sensors_[i]->pin_) == HIGH) {
+			sample |= bitMasks_[i];
+		}
+	}
+	return sample;
+}
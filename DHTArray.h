@@ -0,0 +1,78 @@
+#ifndef DHT_ARRAY_H
+#define DHT_ARRAY_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Multi-sensor reader, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// the most sensors a single DHTArray can read at once
+#define DHT_ARRAY_MAX_SENSORS 8
+
+// DHTArray::poll() returns this while a read is still in flight
+#define DHT_ARRAY_READ_IN_PROGRESS -1
+
+// on AVR, if all the sensors are on the same port, we can sample all of them
+// with a single read of the port's input register
+#if defined(__AVR__)
+ #define DHT_ARRAY_PORT_READS
+#endif
+
+class DHTArray {
+
+	public:
+
+		// constructor and initializer; add() should be called for each
+		// sensor before begin(), and returns false if the array is full.
+		// begin() calls begin() on each of the sensors.
+		DHTArray();
+		boolean add(DHT &sensor);
+		void begin();
+
+		// these work just like the DHT functions of the same names, except
+		// that they send the start signal to all the sensors at once, and then
+		// record all of the sensors' data signals in a single timing loop,
+		// so reading N sensors costs about the same as reading one.
+		//
+		// Once a read is finished, the data is available from each sensor's
+		// get*() functions, as though it had been read individually.
+		// readSensorData() and poll() return a bitmask with a bit set for
+		// each sensor (in the order they were added) holding valid data;
+		// poll() returns DHT_ARRAY_READ_IN_PROGRESS while a read is in flight.
+		//
+		// The sample window is that of the slowest sensor in the array.
+		// Sensors in an array shouldn't also be read individually.
+		uint8_t readSensorData();
+		boolean startRead();
+		int16_t poll();
+
+
+	private:
+
+		DHT *sensors_[DHT_ARRAY_MAX_SENSORS];
+		uint8_t numSensors_;
+
+		uint16_t minSampleDelayMillis_;
+		unsigned long lastReadTime_;
+		boolean firstReading_;
+		uint8_t validMask_;
+
+		uint8_t readPhase_;
+		uint8_t startDelayMillis_;
+		unsigned long phaseStartTime_;
+
+#ifdef DHT_ARRAY_PORT_READS
+		volatile uint8_t *inputRegister_;
+#endif
+		uint8_t bitMasks_[DHT_ARRAY_MAX_SENSORS];
+
+		void capturePulses();
+		uint8_t samplePins();
+
+};
+
+#endif
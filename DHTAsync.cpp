@@ -0,0 +1,177 @@
+/***************************************************************************
+ * Interrupt-driven background reads, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+#include "DHTAsync.h"
+#include "string.h"
+
+DHTAsync::DHTAsync(uint8_t pin, uint8_t type) {
+	pin_ = pin;
+	type_ = type;
+	phase_ = DHT_PHASE_IDLE;
+	firstReading_ = true;
+	numEdges_ = 0;
+	front_ = 0;
+	frameCount_ = 0;
+	status_ = DHT_READ_NOT_STARTED;
+
+	// neither buffer passes its checksum until a frame is published
+	memset(frames_, 0, sizeof(frames_));
+	frames_[0][0] = 0xFF;
+	frames_[1][0] = 0xFF;
+}
+
+void DHTAsync::begin(void (*edgeHandler)()) {
+	// set up the pin, and let it float up until the first read
+	pinMode(pin_, INPUT);
+	digitalWrite(pin_, HIGH);
+	phaseStartTime_ = millis();
+	attachInterrupt(digitalPinToInterrupt(pin_), edgeHandler, FALLING);
+}
+
+uint16_t DHTAsync::getMinSampleDelayMillis() {
+	return DHTRuntimeType::getMinSampleDelayMillis(type_);
+}
+
+void DHTAsync::timerTick() {
+	// because these are unsigned values, the elapsed time checks below work
+	// even for rollovers
+	unsigned long elapsed = millis() - phaseStartTime_;
+
+	switch (phase_) {
+		case DHT_PHASE_IDLE:
+			if (elapsed < (firstReading_ ? DHT_FIRST_START_DELAY : getMinSampleDelayMillis())) {
+				break;
+			}
+			// the line has been HIGH since the end of the last read, so
+			// there's no need for a start delay; pull it low for the start
+			// signal
+			firstReading_ = false;
+			pinMode(pin_, OUTPUT);
+			digitalWrite(pin_, LOW);
+			phaseStartTime_ = millis();
+			phase_ = DHT_PHASE_START_SIGNAL;
+			break;
+		case DHT_PHASE_START_SIGNAL:
+			if (elapsed < DHT_START_SIGNAL_MILLIS) {
+				break;
+			}
+			// get ready for the edges before letting the line go, since the
+			// sensor answers within microseconds; the start signal's time
+			// stays in phaseStartTime_, so the sample window is measured
+			// from it
+			numEdges_ = 0;
+			memset(frames_[front_ ^ 1], 0, DHT_NUM_BYTES);
+			phase_ = DHT_ASYNC_PHASE_CAPTURE;
+			digitalWrite(pin_, HIGH);
+			pinMode(pin_, INPUT);
+			break;
+		case DHT_ASYNC_PHASE_CAPTURE:
+			if (elapsed >= DHT_START_SIGNAL_MILLIS + DHT_ASYNC_CAPTURE_TIMEOUT_MILLIS) {
+				// we never saw the end of the read, oops
+				finishCapture(DHT_READ_TIMEOUT);
+			}
+			break;
+	}
+}
+
+void DHTAsync::handleEdge() {
+	unsigned long now;
+	uint16_t period;
+	uint8_t edge, bit, *data;
+
+	if (phase_ != DHT_ASYNC_PHASE_CAPTURE) {
+		// our own start signal, or noise between reads
+		return;
+	}
+
+	// because these are unsigned values, this works even for rollovers
+	now = micros();
+	period = now - lastEdgeMicros_;
+	lastEdgeMicros_ = now;
+	edge = numEdges_++;
+
+	if (edge == 0) {
+		// the start of the response; nothing to time yet
+		return;
+	}
+	if (edge == 1) {
+		// the whole response, ~160 microseconds; 5/8 of it falls halfway
+		// between a "0" bit's ~76 and a "1" bit's ~120
+		bitThresholdMicros_ = period * 5 / 8;
+		return;
+	}
+
+	// the bits come out high-order bits first, and the buffer is
+	// "backwards", as in DHT::decodePulses()
+	bit = edge - 2;
+	data = frames_[front_ ^ 1] + (DHT_NUM_BYTES-1 - bit/8);
+	*data = (*data << 1) | (period >= bitThresholdMicros_);
+
+	if (edge == DHT_ASYNC_NUM_EDGES-1) {
+		finishCapture(DHTFrame::checksumMatches(frames_[front_ ^ 1]) ? DHT_READ_OK : DHT_READ_CHECKSUM_ERROR);
+	}
+}
+
+void DHTAsync::finishCapture(uint8_t status) {
+	if (status == DHT_READ_OK) {
+		// publish the frame; this single write is what makes it visible
+		front_ ^= 1;
+		frameCount_++;
+	}
+	status_ = status;
+	phase_ = DHT_PHASE_IDLE;
+}
+
+void DHTAsync::readFront(uint8_t *data) {
+	memcpy(data, frames_[front_], DHT_NUM_BYTES);
+}
+
+boolean DHTAsync::getFrame(DHTFrame &frame) {
+	frame.type = type_;
+	readFront(frame.data);
+	return frame.isChecksumValid();
+}
+
+float DHTAsync::getTemperatureCelsius() {
+	DHTFrame frame;
+
+	getFrame(frame);
+	return frame.getTemperatureCelsius();
+}
+
+float DHTAsync::getTemperatureFahrenheit() {
+	return DHT_TempHumidUtils::convertCelsiusToFahrenheit(getTemperatureCelsius());
+}
+
+float DHTAsync::getPercentHumidity() {
+	DHTFrame frame;
+
+	getFrame(frame);
+	return frame.getPercentHumidity();
+}
+
+int16_t DHTAsync::getTemperatureTenthsC() {
+	DHTFrame frame;
+
+	getFrame(frame);
+	return frame.getTemperatureTenthsC();
+}
+
+int16_t DHTAsync::getHumidityTenths() {
+	DHTFrame frame;
+
+	getFrame(frame);
+	return frame.getHumidityTenths();
+}
+
+uint8_t DHTAsync::getFrameCount() {
+	return frameCount_;
+}
+
+uint8_t DHTAsync::getStatus() {
+	return status_;
+}
@@ -0,0 +1,132 @@
+#ifndef DHT_ASYNC_H
+#define DHT_ASYNC_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Interrupt-driven background reads, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// DHTAsync reads a sensor entirely from interrupt handlers, so the main loop
+// never waits on it at all, not even for the ~5 millisecond burst that
+// poll() blocks for.  Two handlers do the work:
+//
+// - timerTick() runs the start signal.  It should be called about once a
+//   millisecond (the start signal is timed in whole milliseconds), from a
+//   timer interrupt, or from the main loop if that's frequent enough; it
+//   returns after a few microseconds either way.
+// - handleEdge() runs on every falling edge of the data line, from the
+//   external (or pin change) interrupt for the sensor's pin.  It decodes
+//   each bit as it arrives, and publishes the frame once all 40 are in.
+//
+// Example, with the sensor on pin 2:
+//
+//     DHTAsync dht(2, DHT_SENSOR_TYPE_DHT22);
+//     void onDhtEdge() { dht.handleEdge(); }
+//     ISR(TIMER2_COMPA_vect) { dht.timerTick(); }  // set up for 1kHz
+//
+//     void setup() { dht.begin(onDhtEdge); ... }
+//     void loop() { ... dht.getTemperatureCelsius() ... }
+//
+// Each bit is timed from one falling edge to the next: the ~50 microsecond
+// LOW before the bit, plus its ~26 or ~70 microsecond HIGH.  The sensor's
+// response (~80 microseconds LOW, then ~80 HIGH) is timed the same way, and
+// 5/8 of it is the threshold between a "0" and a "1", so the threshold
+// scales with the sensor's clock just as computeBitThreshold()'s does.
+// Timing whole periods also means a late interrupt (say, one held off by
+// another handler) only shifts one edge, which the next bit makes up for.
+//
+// Decoded frames are published into one of two buffers, while the get*()
+// functions read from the other, so a frame is never read half-written:
+// the handler writes into the back buffer, and only switches the buffers
+// (a single byte write) once the frame has passed its checksum.  The back
+// buffer isn't written again until the next read, a whole sample window
+// later, so a frame that's being read when a new one is published is still
+// read whole.
+//
+// Unlike DHT, there's no retry policy, no fallback and no error correction
+// here; a read that fails just leaves the last good frame in place, and the
+// next read comes one sample window later.
+
+// milliseconds after the start signal for all the edges to arrive, before
+// the read is given up on
+#define DHT_ASYNC_CAPTURE_TIMEOUT_MILLIS 10
+
+// the phase in which handleEdge() is capturing a read, following on from
+// DHT_PHASE_IDLE and DHT_PHASE_START_SIGNAL
+#define DHT_ASYNC_PHASE_CAPTURE 3
+
+// the falling edges of a read: the start of the response, the start of
+// each bit, and the start of the final LOW
+#define DHT_ASYNC_NUM_EDGES (2 + DHT_NUM_BYTES*8)
+
+class DHTAsync {
+
+	public:
+
+		// constructor and initializer; begin() attaches edgeHandler (which
+		// should just call handleEdge()) to the pin's falling edges, and the
+		// first read starts DHT_FIRST_START_DELAY milliseconds later
+		DHTAsync(uint8_t pin, uint8_t type);
+		void begin(void (*edgeHandler)());
+
+		// the interrupt handlers; see above
+		void timerTick();
+		void handleEdge();
+
+		// the values from the most recently published frame; these return
+		// NAN or DHT_INVALID_TENTHS until the first good read
+		float getTemperatureCelsius();
+		float getTemperatureFahrenheit();
+		float getPercentHumidity();
+		int16_t getTemperatureTenthsC();
+		int16_t getHumidityTenths();
+
+		// copies the most recently published frame; returns false if there
+		// hasn't been one yet
+		boolean getFrame(DHTFrame &frame);
+
+		// counts the frames published so far (rolling over at 255), so the
+		// main loop can tell when there's a new one
+		uint8_t getFrameCount();
+
+		// the status of the most recently finished read (DHT_READ_OK,
+		// DHT_READ_TIMEOUT or DHT_READ_CHECKSUM_ERROR), or
+		// DHT_READ_NOT_STARTED before the first one has finished
+		uint8_t getStatus();
+
+		uint16_t getMinSampleDelayMillis();
+
+
+	private:
+
+		uint8_t pin_, type_;
+
+		// DHT_PHASE_IDLE (waiting out the sample window),
+		// DHT_PHASE_START_SIGNAL or DHT_ASYNC_PHASE_CAPTURE
+		volatile uint8_t phase_;
+		unsigned long phaseStartTime_;
+		boolean firstReading_;
+
+		// the capture in progress
+		volatile uint8_t numEdges_;
+		unsigned long lastEdgeMicros_;
+		uint16_t bitThresholdMicros_;
+
+		// frames_[front_] is the published frame, and the other one is where
+		// the next is decoded into; each is in the same order as a data
+		// buffer (checksum first)
+		uint8_t frames_[2][DHT_NUM_BYTES];
+		volatile uint8_t front_;
+		volatile uint8_t frameCount_;
+		volatile uint8_t status_;
+
+		void finishCapture(uint8_t status);
+		void readFront(uint8_t *data);
+
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef DHT_FAST_H
+#define DHT_FAST_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Compile-time pin variant of the DHT class, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// DHTFast works just like DHT, except that the pin is part of the type, and
+// the pin is read through a "pin policy" class instead of digitalRead().
+// On AVR, digitalRead() alone takes dozens of cycles, which limits how
+// finely the signal lengths can be measured; reading the port register
+// directly takes just a couple.  Example:
+//
+//     DHTFast<DHTPortPin<2> > dht(DHT_SENSOR_TYPE_DHT22);
+//
+// A pin policy is a class with a PIN constant (used for everything other
+// than reading the pin during the timing loop), a static begin() function
+// which is called from the DHTFast constructor, and a static read()
+// function returning HIGH or LOW.
+//
+// The pin policy is picked at compile time, by the functions below hiding
+// DHT's functions of the same names, so it's only used when they're called
+// on a DHTFast.  Through a DHT pointer or reference, a DHTFast reads its pin
+// with digitalRead() just like a DHT; to schedule DHTFast objects without
+// losing the fast path, use a DHTBasicScheduler of them (see DHTScheduler.h)
+// rather than a DHTScheduler.
+template <class PinPolicy>
+class DHTFast : public DHT {
+
+	public:
+
+		DHTFast(uint8_t type) : DHT(PinPolicy::PIN, type) {
+			PinPolicy::begin();
+		}
+
+		boolean readSensorData() {
+			return readSensorDataWith(PinPolicy());
+		}
+
+		boolean readSensorData(DHTFrame &frame) {
+			return fillFrame(frame, readSensorData());
+		}
+
+		uint8_t poll() {
+			return pollWith(PinPolicy());
+		}
+
+		// the same as DHT's read*() functions, but reading through PinPolicy
+		float readTemperatureCelsius() {
+			return readSensorData() ? getTemperatureCelsius() : NAN;
+		}
+
+		float readTemperatureFahrenheit() {
+			return DHT_TempHumidUtils::convertCelsiusToFahrenheit(readTemperatureCelsius());
+		}
+
+		float readPercentHumidity() {
+			return readSensorData() ? getPercentHumidity() : NAN;
+		}
+
+		float readHeatIndexCelsius() {
+			if (!readSensorData()) {
+				return NAN;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexCelsius(getTemperatureCelsius(), getPercentHumidity());
+		}
+
+		float readHeatIndexFahrenheit() {
+			if (!readSensorData()) {
+				return NAN;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexFahrenheit(getTemperatureFahrenheit(), getPercentHumidity());
+		}
+
+		int16_t readHeatIndexTenthsC() {
+			if (!readSensorData()) {
+				return DHT_INVALID_TENTHS;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexTenthsCelsius(getTemperatureTenthsC(), getHumidityTenths());
+		}
+
+		int16_t readHeatIndexTenthsF() {
+			if (!readSensorData()) {
+				return DHT_INVALID_TENTHS;
+			}
+			return DHT_TempHumidUtils::computeHeatIndexTenthsFahrenheit(getTemperatureTenthsF(), getHumidityTenths());
+		}
+
+		boolean readAll(DHTReading &reading) {
+			readSensorData();
+			return updateReading(reading);
+		}
+
+};
+
+
+// this policy works everywhere, but isn't any faster than plain DHT
+template <uint8_t PIN_NUMBER>
+class DHTDigitalPin {
+
+	public:
+
+		static const uint8_t PIN = PIN_NUMBER;
+		static void begin() {}
+		static uint8_t read() {
+			return digitalRead(PIN);
+		}
+
+};
+
+
+#if defined(portInputRegister)
+
+// this policy looks up the pin's port input register and bit mask once, and
+// from then on reads the register directly; it works on any board whose
+// core provides portInputRegister(), digitalPinToPort() and
+// digitalPinToBitMask()
+template <uint8_t PIN_NUMBER>
+class DHTPortPin {
+
+	public:
+
+		static const uint8_t PIN = PIN_NUMBER;
+		static void begin() {
+			inputRegister_ = portInputRegister(digitalPinToPort(PIN));
+			bitMask_ = digitalPinToBitMask(PIN);
+		}
+		static uint8_t read() {
+			return (*inputRegister_ & bitMask_) ? HIGH : LOW;
+		}
+
+	private:
+
+		static decltype(portInputRegister(digitalPinToPort(PIN_NUMBER))) inputRegister_;
+		static decltype(digitalPinToBitMask(PIN_NUMBER)) bitMask_;
+
+};
+
+template <uint8_t PIN_NUMBER>
+decltype(portInputRegister(digitalPinToPort(PIN_NUMBER))) DHTPortPin<PIN_NUMBER>::inputRegister_;
+
+template <uint8_t PIN_NUMBER>
+decltype(digitalPinToBitMask(PIN_NUMBER)) DHTPortPin<PIN_NUMBER>::bitMask_;
+
+#endif
+
+
+#if defined(__AVR__)
+
+// this policy reads a register whose address is known at compile time, so
+// read() compiles down to a single instruction or two; REGISTER_ADDRESS is
+// the data memory address of the pin's PINx register, and BIT is the pin's
+// bit within it.  For example, pin 2 on an ATmega328P is bit 2 of PIND,
+// which lives at 0x29:
+//
+//     DHTFast<DHTRegisterPin<2, 0x29, 2> > dht(DHT_SENSOR_TYPE_DHT22);
+template <uint8_t PIN_NUMBER, uint16_t REGISTER_ADDRESS, uint8_t BIT>
+class DHTRegisterPin {
+
+	public:
+
+		static const uint8_t PIN = PIN_NUMBER;
+		static void begin() {}
+		static uint8_t read() {
+			return (*(volatile uint8_t *)REGISTER_ADDRESS & (1<<BIT)) ? HIGH : LOW;
+		}
+
+};
+
+#endif
+
+#endif
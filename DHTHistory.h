@@ -0,0 +1,310 @@
+#ifndef DHT_HISTORY_H
+#define DHT_HISTORY_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Fixed-size reading history, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// DHTHistory keeps the last N readings of a sensor, along with their rolling
+// min, max, mean and exponential moving average, without any floats.  Each
+// reading is stored as the same 16-bit tenths the get*Tenths*() functions
+// return, plus a 16-bit count of the milliseconds since the reading before
+// it, so a reading costs 6 bytes, and the min/max tracking another 4.  Every
+// statistic is kept up to date as readings are added, so asking for one
+// never has to look through the buffer.  Example:
+//
+//     DHTHistory<30> history;
+//     ...
+//     if (dht.readSensorData()) {
+//         history.add(dht);
+//     }
+//     if (history.getMaxTemperatureTenthsC() > 300) ...
+//
+// N can be at most 255.  The EMA weighs each new reading by 1/2^EMA_SHIFT,
+// so the default of 3 follows the last 8 or so readings.  Gaps of more than
+// about 65 seconds between readings are recorded as 65535 milliseconds.
+#define DHT_HISTORY_MAX_DELTA_MILLIS 0xFFFF
+
+
+// one series of values (either temperature or humidity) in the history;
+// this is the bookkeeping DHTHistory does twice, and isn't meant to be used
+// on its own
+template <uint8_t N, uint8_t EMA_SHIFT>
+class DHTHistorySeries {
+
+	public:
+
+		void clear() {
+			sum_ = 0;
+			emaScaled_ = 0;
+			minHead_ = minCount_ = 0;
+			maxHead_ = maxCount_ = 0;
+		}
+
+		// store value at position index of the ring buffer; if that position
+		// already held a value, it's the oldest one and drops out of the window
+		void add(uint8_t index, int16_t value, boolean replacing, boolean first) {
+			if (replacing) {
+				sum_ -= values_[index];
+				// the oldest value can only be at the front of the queues
+				if (minCount_ && minQueue_[minHead_] == index) {
+					minHead_ = next(minHead_);
+					minCount_--;
+				}
+				if (maxCount_ && maxQueue_[maxHead_] == index) {
+					maxHead_ = next(maxHead_);
+					maxCount_--;
+				}
+			}
+			values_[index] = value;
+			sum_ += value;
+
+			// the min queue holds increasing values, and the max queue
+			// decreasing values; anything the new value beats can never be
+			// the min (or max) again, since the new value will outlast it
+			while (minCount_ && values_[minQueue_[back(minHead_, minCount_)]] >= value) {
+				minCount_--;
+			}
+			minQueue_[at(minHead_, minCount_++)] = index;
+			while (maxCount_ && values_[maxQueue_[back(maxHead_, maxCount_)]] <= value) {
+				maxCount_--;
+			}
+			maxQueue_[at(maxHead_, maxCount_++)] = index;
+
+			// this is the usual ema += (value - ema) / 2^EMA_SHIFT, kept
+			// scaled up by 2^EMA_SHIFT so no precision is lost to the shift
+			if (first) {
+				emaScaled_ = (int32_t)value << EMA_SHIFT;
+			} else {
+				emaScaled_ += value - (emaScaled_ >> EMA_SHIFT);
+			}
+		}
+
+		int16_t get(uint8_t index) {
+			return values_[index];
+		}
+
+		int16_t getMin() {
+			return values_[minQueue_[minHead_]];
+		}
+
+		int16_t getMax() {
+			return values_[maxQueue_[maxHead_]];
+		}
+
+		int16_t getMean(uint8_t count) {
+			// round to the nearest tenth, rather than toward zero
+			if (sum_ < 0) {
+				return (sum_ - count/2) / count;
+			}
+			return (sum_ + count/2) / count;
+		}
+
+		int16_t getEMA() {
+			return (emaScaled_ + (1 << EMA_SHIFT >> 1)) >> EMA_SHIFT;
+		}
+
+	private:
+
+		static uint8_t next(uint8_t index) {
+			return (index == N-1) ? 0 : index+1;
+		}
+		static uint8_t at(uint8_t head, uint8_t offset) {
+			return (head + offset) % N;
+		}
+		static uint8_t back(uint8_t head, uint8_t count) {
+			return at(head, count-1);
+		}
+
+		int16_t values_[N];
+		int32_t sum_;
+		int32_t emaScaled_;
+
+		// these are ring buffers of positions in values_; the front of each
+		// is the position of the current min (or max)
+		uint8_t minQueue_[N];
+		uint8_t minHead_;
+		uint8_t minCount_;
+		uint8_t maxQueue_[N];
+		uint8_t maxHead_;
+		uint8_t maxCount_;
+
+};
+
+
+template <uint8_t N, uint8_t EMA_SHIFT = 3>
+class DHTHistory {
+
+	public:
+
+		DHTHistory() {
+			clear();
+		}
+
+		void clear() {
+			temperature_.clear();
+			humidity_.clear();
+			next_ = 0;
+			count_ = 0;
+			newestTime_ = 0;
+			deltaSum_ = 0;
+		}
+
+		// add a reading, timestamped with millis() at the time it was taken;
+		// readings should be added oldest first
+		void add(int16_t temperatureTenthsC, int16_t humidityTenths, unsigned long timestamp) {
+			boolean replacing = (count_ == N);
+			boolean first = (count_ == 0);
+			unsigned long delta;
+
+			// because these are unsigned values, this works even for rollovers
+			delta = first ? 0 : timestamp - newestTime_;
+			if (delta > DHT_HISTORY_MAX_DELTA_MILLIS) {
+				delta = DHT_HISTORY_MAX_DELTA_MILLIS;
+			}
+			if (replacing) {
+				deltaSum_ -= deltas_[next_];
+			}
+			deltas_[next_] = delta;
+			deltaSum_ += delta;
+			newestTime_ = timestamp;
+
+			temperature_.add(next_, temperatureTenthsC, replacing, first);
+			humidity_.add(next_, humidityTenths, replacing, first);
+
+			next_ = (next_ == N-1) ? 0 : next_+1;
+			if (!replacing) {
+				count_++;
+			}
+		}
+
+		// add the sensor's (a DHT, DHTSensor or DHTFast) current values, if
+		// it has valid ones that haven't been added already (such as when a
+		// read came from the cache or fell back to the last good value);
+		// returns whether anything was added
+		template <class Sensor> boolean add(Sensor &sensor) {
+			int16_t temperature = sensor.getTemperatureTenthsC();
+			if (temperature == DHT_INVALID_TENTHS) {
+				return false;
+			}
+			if (count_ && sensor.getValueTimestamp() == newestTime_) {
+				return false;
+			}
+			add(temperature, sensor.getHumidityTenths(), sensor.getValueTimestamp());
+			return true;
+		}
+
+		uint8_t size() {
+			return count_;
+		}
+
+		uint8_t capacity() {
+			return N;
+		}
+
+		boolean isFull() {
+			return count_ == N;
+		}
+
+		// the readings themselves, where age 0 is the newest; these return
+		// DHT_INVALID_TENTHS if there is no reading that old
+		int16_t getTemperatureTenthsC(uint8_t age) {
+			if (age >= count_) {
+				return DHT_INVALID_TENTHS;
+			}
+			return temperature_.get(indexOf(age));
+		}
+
+		int16_t getHumidityTenths(uint8_t age) {
+			if (age >= count_) {
+				return DHT_INVALID_TENTHS;
+			}
+			return humidity_.get(indexOf(age));
+		}
+
+		// when the reading of the given age was taken, or 0 if there is no
+		// reading that old; only the newest timestamp is stored, so this adds
+		// up the deltas back to the reading, which takes time proportional to
+		// its age
+		unsigned long getTimestamp(uint8_t age) {
+			unsigned long timestamp = newestTime_;
+			uint8_t index = indexOf(0);
+
+			if (age >= count_) {
+				return 0;
+			}
+			while (age-- > 0) {
+				timestamp -= deltas_[index];
+				index = (index == 0) ? N-1 : index-1;
+			}
+			return timestamp;
+		}
+
+		// the time between the oldest and newest readings; this is kept as the
+		// sum of the deltas, so each gap in it is capped just like they are
+		unsigned long getSpanMillis() {
+			if (!count_) {
+				return 0;
+			}
+			// the oldest reading's delta is to a reading that's no longer here
+			return deltaSum_ - deltas_[indexOf(count_-1)];
+		}
+
+		// rolling statistics over all the readings in the history, in tenths;
+		// these return DHT_INVALID_TENTHS while the history is empty
+		int16_t getMinTemperatureTenthsC() {
+			return count_ ? temperature_.getMin() : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getMaxTemperatureTenthsC() {
+			return count_ ? temperature_.getMax() : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getMeanTemperatureTenthsC() {
+			return count_ ? temperature_.getMean(count_) : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getEMATemperatureTenthsC() {
+			return count_ ? temperature_.getEMA() : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getMinHumidityTenths() {
+			return count_ ? humidity_.getMin() : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getMaxHumidityTenths() {
+			return count_ ? humidity_.getMax() : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getMeanHumidityTenths() {
+			return count_ ? humidity_.getMean(count_) : DHT_INVALID_TENTHS;
+		}
+
+		int16_t getEMAHumidityTenths() {
+			return count_ ? humidity_.getEMA() : DHT_INVALID_TENTHS;
+		}
+
+	private:
+
+		// the position in the ring buffer of the reading of the given age
+		uint8_t indexOf(uint8_t age) {
+			uint8_t newest = (next_ == 0) ? N-1 : next_-1;
+			return (newest >= age) ? newest - age : newest + N - age;
+		}
+
+		DHTHistorySeries<N, EMA_SHIFT> temperature_;
+		DHTHistorySeries<N, EMA_SHIFT> humidity_;
+		uint16_t deltas_[N];
+		unsigned long newestTime_;
+		unsigned long deltaSum_;
+		uint8_t next_;
+		uint8_t count_;
+
+};
+
+#endif
@@ -0,0 +1,249 @@
+/***************************************************************************
+ * Compact binary log of readings, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+#include "DHTLog.h"
+#include "string.h"
+
+static void writeUint16(uint8_t *p, uint16_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static uint16_t readUint16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+// CRC-16/CCITT-FALSE, a bit at a time, so there's no table taking up flash;
+// a block's records are only a few dozen bytes
+#define DHT_LOG_CRC_INITIAL 0xFFFF
+
+static uint16_t updateCrc16(uint16_t crc, const uint8_t *p, uint16_t length) {
+	uint8_t bit;
+
+	while (length--) {
+		crc ^= (uint16_t)*p++ << 8;
+		for (bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+// 7 bits at a time, low-order bits first, with the high bit of each byte set
+// if more bytes follow
+static uint8_t* writeVarint(uint8_t *p, uint32_t value) {
+	while (value >= 0x80) {
+		*p++ = value | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+	return p;
+}
+
+// returns NULL if the varint runs past end, or is too long to be one we wrote
+static inline const uint8_t* readVarint(const uint8_t *p, const uint8_t *end, uint32_t &value) {
+	uint8_t shift = 0;
+
+	value = 0;
+	do {
+		if (p == end || shift > 28) {
+			return NULL;
+		}
+		value |= (uint32_t)(*p & 0x7F) << shift;
+		shift += 7;
+	} while (*p++ & 0x80);
+	return p;
+}
+
+// zigzag encoding maps small differences of either sign to small unsigned
+// values (0, -1, 1, -2, ... become 0, 1, 2, 3, ...), so they make short
+// varints
+static uint16_t zigzag(int16_t value) {
+	return ((uint16_t)value << 1) ^ (uint16_t)(value >> 15);
+}
+
+static int16_t unzigzag(uint16_t value) {
+	return (value >> 1) ^ -(int16_t)(value & 1);
+}
+
+
+DHTLog::DHTLog(uint8_t sensorId) {
+	block_[2] = sensorId;
+	clear();
+}
+
+void DHTLog::clear() {
+	uint8_t sensorId = block_[2];
+
+	memset(block_, 0, DHT_LOG_BLOCK_SIZE);
+	block_[0] = DHT_LOG_MAGIC;
+	block_[1] = DHT_LOG_VERSION;
+	block_[2] = sensorId;
+	writeUint16(block_ + 4, DHT_LOG_BLOCK_SIZE);
+	crc_ = DHT_LOG_CRC_INITIAL;
+	writeUint16(block_ + 10, crc_);
+
+	used_ = DHT_LOG_HEADER_SIZE;
+	numRecords_ = 0;
+	lastHumidity_ = 0;
+	lastTemperature_ = 0;
+}
+
+boolean DHTLog::addSensor(DHTCore &sensor, uint8_t type) {
+	uint8_t flags = sensor.readStatus_ & DHT_LOG_STATUS_MASK;
+
+	if (sensor.corrected_) {
+		flags |= DHT_LOG_FLAG_CORRECTED;
+	}
+	if (sensor.validData_ && sensor.readStatus_ != DHT_READ_OK) {
+		flags |= DHT_LOG_FLAG_FALLBACK;
+	}
+	return addRecord(type, flags, sensor.validData_ ? sensor.data_ : NULL, millis());
+}
+
+boolean DHTLog::addRecord(uint8_t type, uint8_t flags, const uint8_t *data, unsigned long timestamp) {
+	uint8_t record[DHT_LOG_MAX_RECORD_SIZE];
+	uint8_t *p = record;
+	uint16_t humidity, temperature;
+
+	if (numRecords_ > 0 && type != block_[3]) {
+		return false;
+	}
+
+	// the first record's time is in the header, so its delta is 0; because
+	// these are unsigned values, the others work even for rollovers
+	*p++ = (flags & ~DHT_LOG_FLAG_VALUES) | (data ? DHT_LOG_FLAG_VALUES : 0);
+	p = writeVarint(p, (numRecords_ > 0) ? (uint32_t)(timestamp - lastTime_) : 0);
+	if (data) {
+		// the raw words, as sent by the sensor
+		humidity = (data[4] << 8) | data[3];
+		temperature = (data[2] << 8) | data[1];
+		p = writeVarint(p, zigzag((int16_t)(humidity - lastHumidity_)));
+		p = writeVarint(p, zigzag((int16_t)(temperature - lastTemperature_)));
+	}
+
+	if (used_ + (p - record) > DHT_LOG_BLOCK_SIZE) {
+		return false;
+	}
+
+	if (numRecords_ == 0) {
+		block_[3] = type;
+		block_[12] = timestamp;
+		block_[13] = timestamp >> 8;
+		block_[14] = timestamp >> 16;
+		block_[15] = timestamp >> 24;
+	}
+	memcpy(block_ + used_, record, p - record);
+	used_ += p - record;
+	numRecords_++;
+	crc_ = updateCrc16(crc_, record, p - record);
+	writeUint16(block_ + 6, used_ - DHT_LOG_HEADER_SIZE);
+	writeUint16(block_ + 8, numRecords_);
+	writeUint16(block_ + 10, crc_);
+
+	lastTime_ = timestamp;
+	if (data) {
+		lastHumidity_ = humidity;
+		lastTemperature_ = temperature;
+	}
+	return true;
+}
+
+const uint8_t* DHTLog::getBlock() {
+	return block_;
+}
+
+uint16_t DHTLog::getNumRecords() {
+	return numRecords_;
+}
+
+/* static */ boolean DHTLog::isValidBlock(const uint8_t *block, uint32_t available) {
+	return available >= DHT_LOG_HEADER_SIZE && block[0] == DHT_LOG_MAGIC && block[1] == DHT_LOG_VERSION &&
+		getBlockSize(block) >= DHT_LOG_HEADER_SIZE && getBlockSize(block) <= available &&
+		readUint16(block + 6) <= getBlockSize(block) - DHT_LOG_HEADER_SIZE &&
+		readUint16(block + 10) == updateCrc16(DHT_LOG_CRC_INITIAL, block + DHT_LOG_HEADER_SIZE, readUint16(block + 6));
+}
+
+/* static */ uint16_t DHTLog::getBlockSize(const uint8_t *block) {
+	return readUint16(block + 4);
+}
+
+/* static */ uint16_t DHTLog::getBlockNumRecords(const uint8_t *block) {
+	return readUint16(block + 8);
+}
+
+/* static */ uint8_t DHTLog::getBlockSensorId(const uint8_t *block) {
+	return block[2];
+}
+
+/* static */ uint8_t DHTLog::getBlockSensorType(const uint8_t *block) {
+	return block[3];
+}
+
+// the record loop is written once per type of sensor, as in DHTSensor, so
+// the values are decoded without switching on the type for every record
+template <class Traits>
+static int32_t decodeRecords(const uint8_t *block, uint32_t *timestamps, uint8_t *flags,
+		int16_t *temperatureTenthsC, int16_t *humidityTenths) {
+	const uint8_t *p = block + DHT_LOG_HEADER_SIZE;
+	const uint8_t *end = p + readUint16(block + 6);
+	uint16_t numRecords = readUint16(block + 8);
+	uint16_t humidity = 0, temperature = 0, recordIndex;
+	uint32_t time, delta;
+	uint8_t data[DHT_NUM_BYTES];
+
+	time = (uint32_t)block[12] | ((uint32_t)block[13] << 8) | ((uint32_t)block[14] << 16) | ((uint32_t)block[15] << 24);
+	for (recordIndex = 0; recordIndex < numRecords; recordIndex++) {
+		if (p == end) {
+			return -1;
+		}
+		flags[recordIndex] = *p++;
+		if (!(p = readVarint(p, end, delta))) {
+			return -1;
+		}
+		time += delta;
+		timestamps[recordIndex] = time;
+
+		if (!(flags[recordIndex] & DHT_LOG_FLAG_VALUES)) {
+			temperatureTenthsC[recordIndex] = DHT_INVALID_TENTHS;
+			humidityTenths[recordIndex] = DHT_INVALID_TENTHS;
+			continue;
+		}
+		if (!(p = readVarint(p, end, delta))) {
+			return -1;
+		}
+		humidity += unzigzag(delta);
+		if (!(p = readVarint(p, end, delta))) {
+			return -1;
+		}
+		temperature += unzigzag(delta);
+
+		// rebuild the data buffer the values came from (the checksum byte
+		// isn't needed to decode them)
+		data[4] = humidity >> 8;
+		data[3] = humidity;
+		data[2] = temperature >> 8;
+		data[1] = temperature;
+		data[0] = data[1] + data[2] + data[3] + data[4];
+		temperatureTenthsC[recordIndex] = Traits::decodeTemperatureTenths(data);
+		humidityTenths[recordIndex] = Traits::decodeHumidityTenths(data);
+	}
+
+	// the records should fill exactly as many bytes as the header says
+	if (p != end) {
+		return -1;
+	}
+	return numRecords;
+}
+
+/* static */ int32_t DHTLog::decodeBlock(const uint8_t *block, uint32_t *timestamps, uint8_t *flags,
+		int16_t *temperatureTenthsC, int16_t *humidityTenths) {
+	if (getBlockSensorType(block) == DHT_SENSOR_TYPE_DHT11) {
+		return decodeRecords<DHTSensorTraits<DHT_SENSOR_TYPE_DHT11> >(block, timestamps, flags, temperatureTenthsC, humidityTenths);
+	}
+	return decodeRecords<DHTSensorTraits<DHT_SENSOR_TYPE_DHT22> >(block, timestamps, flags, temperatureTenthsC, humidityTenths);
+}
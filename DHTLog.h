@@ -0,0 +1,134 @@
+#ifndef DHT_LOG_H
+#define DHT_LOG_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Compact binary log of readings, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// DHTLog packs readings into fixed-size blocks for writing to an SD card or
+// flash, at a few bytes per reading rather than the dozens a line of CSV
+// text takes.  Each block stands on its own, so a log file is just blocks
+// one after another (from any number of sensors), and a damaged block only
+// loses its own readings.  Example:
+//
+//     DHTLog log(0);
+//     ...
+//     dht.readSensorData();
+//     if (!log.add(dht)) {
+//         file.write(log.getBlock(), DHT_LOG_BLOCK_SIZE);
+//         log.clear();
+//         log.add(dht);
+//     }
+//
+// A block is a 16 byte header followed by records, zero-padded to the end:
+//
+//     byte 0       DHT_LOG_MAGIC
+//     byte 1       DHT_LOG_VERSION
+//     byte 2       sensor id, as passed to the constructor
+//     byte 3       sensor type (DHT_SENSOR_TYPE_*)
+//     bytes 4-5    block size
+//     bytes 6-7    bytes of records in the block
+//     bytes 8-9    number of records in the block
+//     bytes 10-11  CRC-16 of the bytes of records
+//     bytes 12-15  millis() timestamp of the first record
+//
+// with all multi-byte values little-endian.  The CRC is CRC-16/CCITT-FALSE
+// (polynomial 0x1021, starting from 0xFFFF), so a damaged record is caught
+// even when it still decodes.  Each record is a flags byte
+// (the read's status in the low 3 bits, plus the DHT_LOG_FLAG_* bits), then
+// the milliseconds since the previous record (or since the header's
+// timestamp, for the first record) as a varint.  If the record has values,
+// the raw 16-bit humidity and temperature words from the data buffer follow,
+// each as a zigzag varint of the difference from the block's previous
+// values (or from 0, for the first).  Readings that change slowly thus take
+// about 4 bytes each.
+//
+// decodeBlock() turns a block back into readings, decoding the raw words
+// with DHTSensorTraits just as the get*() functions do.
+
+// bytes per block; every block in a file must be the same size, and
+// DHTLog keeps one block in RAM
+#ifndef DHT_LOG_BLOCK_SIZE
+#define DHT_LOG_BLOCK_SIZE 64
+#endif
+
+#define DHT_LOG_MAGIC       0xD7
+#define DHT_LOG_VERSION     2
+#define DHT_LOG_HEADER_SIZE 16
+
+// a record's flags byte
+#define DHT_LOG_STATUS_MASK     0x07
+#define DHT_LOG_FLAG_VALUES     0x08
+#define DHT_LOG_FLAG_CORRECTED  0x10
+#define DHT_LOG_FLAG_FALLBACK   0x20
+
+// the most bytes a single record can take: flags, a 5 byte timestamp delta
+// and two 3 byte value deltas
+#define DHT_LOG_MAX_RECORD_SIZE 12
+
+class DHTLog {
+
+	public:
+
+		DHTLog(uint8_t sensorId);
+
+		// start a new, empty block
+		void clear();
+
+		// add() records the outcome of the sensor's (a DHT, DHTSensor or
+		// DHTFast) most recent read: its status, and its values if it has
+		// valid ones (which may be the last good values, if the retry policy
+		// allows a fallback), stamped with the current millis().
+		// addRecord() does the same with everything passed in, where flags
+		// is a status plus any DHT_LOG_FLAG_* bits, and data is a data
+		// buffer (or NULL, if there are no values).  Both return false,
+		// without adding anything, if the block is full (or holds readings
+		// of another type of sensor); the block should then be written out
+		// and cleared.
+		template <class Sensor> boolean add(Sensor &sensor) {
+			return addSensor(sensor, sensor.getType());
+		}
+		boolean addRecord(uint8_t type, uint8_t flags, const uint8_t *data, unsigned long timestamp);
+
+		// the block so far, always DHT_LOG_BLOCK_SIZE bytes long
+		const uint8_t* getBlock();
+		uint16_t getNumRecords();
+
+		// these read a block's header, and work on a block of any size; the
+		// getters assume isValidBlock() is true
+		static boolean isValidBlock(const uint8_t *block, uint32_t available);
+		static uint16_t getBlockSize(const uint8_t *block);
+		static uint16_t getBlockNumRecords(const uint8_t *block);
+		static uint8_t getBlockSensorId(const uint8_t *block);
+		static uint8_t getBlockSensorType(const uint8_t *block);
+
+		// decode every record in a block into columns, each of which must
+		// have room for getBlockNumRecords() entries; records without values
+		// get DHT_INVALID_TENTHS.  Returns the number of records, or -1 if
+		// the block is damaged (in which case the columns may have been
+		// partly written).
+		static int32_t decodeBlock(const uint8_t *block, uint32_t *timestamps, uint8_t *flags,
+			int16_t *temperatureTenthsC, int16_t *humidityTenths);
+
+
+	private:
+
+		uint8_t block_[DHT_LOG_BLOCK_SIZE];
+		uint16_t used_;
+		uint16_t numRecords_;
+		unsigned long lastTime_;
+		uint16_t lastHumidity_;
+		uint16_t lastTemperature_;
+		uint16_t crc_;
+
+		// add() for any kind of sensor (see DHTBase), given its type
+		boolean addSensor(DHTCore &sensor, uint8_t type);
+
+};
+
+#endif
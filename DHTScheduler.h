@@ -0,0 +1,211 @@
+#ifndef DHT_SCHEDULER_H
+#define DHT_SCHEDULER_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Cooperative multi-sensor scheduler, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// the most sensors a single DHTScheduler can manage
+#define DHT_SCHEDULER_MAX_SENSORS 8
+
+// microseconds to leave free after one sensor's burst before another's may
+// run, so the bursts never land back to back
+#define DHT_SCHEDULER_BURST_GAP_MICROS 5000
+
+// milliseconds a burst may be held off (stretching the start signal) while
+// the caller's budget is too short, before the read is given up on
+#define DHT_SCHEDULER_MAX_DEFER_MILLIS 20
+
+// DHTBasicScheduler works with any one class of sensor (DHT, or a DHTFast
+// or DHTSensor), calling its functions directly, so that a DHTFast keeps
+// its fast path; DHTScheduler, below, is the one for plain DHT objects.
+// Example:
+//
+//     DHTBasicScheduler<DHTFast<DHTPortPin<2> > > scheduler;
+template <class Sensor>
+class DHTBasicScheduler {
+
+	public:
+
+		// constructor and initializer; add() should be called for each
+		// sensor before begin(), and returns false if the scheduler is full.
+		// begin() calls begin() on each of the sensors.
+		DHTBasicScheduler();
+		boolean add(Sensor &sensor);
+		void begin();
+
+		// tick() should be called frequently from the main loop, with the
+		// number of microseconds the caller can spare before its next
+		// deadline.  It moves reads along with startRead() and poll(),
+		// starting one sensor's read at a time, once the one before has
+		// finished, so that sensors whose sample windows come up together
+		// get staggered; a read is only started on a call whose budget would
+		// fit a burst.  A read only blocks for its ~5 millisecond burst, and
+		// tick() only lets that happen when it fits in budgetMicros; it also
+		// runs at most one burst per call, and leaves at least
+		// DHT_SCHEDULER_BURST_GAP_MICROS between bursts.  Otherwise, tick()
+		// returns after a few microseconds.
+		//
+		// The burst is assumed to take DHT_BURST_MICROS, or as long as the
+		// longest one seen so far, if that's longer (up to
+		// DHT_MAX_BURST_MICROS).  If the budget shrinks after a read has
+		// started, and its burst has to be held off for more than
+		// DHT_SCHEDULER_MAX_DEFER_MILLIS, that read is cancelled; see
+		// DHT::cancelRead().
+		//
+		// tick() returns a bitmask with a bit set for each sensor (in the
+		// order they were added) that finished a read during this call;
+		// each sensor's poll() gives the status of that read, and its get*()
+		// functions the data, as usual.  Sensors managed by a scheduler
+		// shouldn't also be read some other way.
+		uint8_t tick(unsigned long budgetMicros);
+
+		// the microseconds of budget tick() currently needs before it will
+		// run a burst, and how many reads it has cancelled so far
+		uint16_t getBurstMicros();
+		uint16_t getCancelledReads();
+
+
+	private:
+
+		Sensor *sensors_[DHT_SCHEDULER_MAX_SENSORS];
+		uint8_t numSensors_;
+
+		// the sensor to consider first for the next burst, so that sensors
+		// whose bursts are due together take turns
+		uint8_t nextSensor_;
+
+		uint16_t burstMicros_;
+		boolean burstGapPending_;
+		unsigned long lastBurstTime_;
+
+		// which sensors have a burst being held off, and since when
+		uint8_t deferredMask_;
+		unsigned long deferredSince_[DHT_SCHEDULER_MAX_SENSORS];
+		uint16_t cancelledReads_;
+
+};
+
+typedef DHTBasicScheduler<DHT> DHTScheduler;
+
+
+template <class Sensor> DHTBasicScheduler<Sensor>::DHTBasicScheduler() {
+	numSensors_ = 0;
+	nextSensor_ = 0;
+	burstMicros_ = DHT_BURST_MICROS;
+	burstGapPending_ = false;
+	deferredMask_ = 0;
+	cancelledReads_ = 0;
+}
+
+template <class Sensor> boolean DHTBasicScheduler<Sensor>::add(Sensor &sensor) {
+	if (numSensors_ >= DHT_SCHEDULER_MAX_SENSORS) {
+		return false;
+	}
+	sensors_[numSensors_++] = &sensor;
+	return true;
+}
+
+template <class Sensor> void DHTBasicScheduler<Sensor>::begin() {
+	uint8_t i;
+
+	for (i = 0; i < numSensors_; i++) {
+		sensors_[i]->begin();
+	}
+}
+
+template <class Sensor> uint8_t DHTBasicScheduler<Sensor>::tick(unsigned long budgetMicros) {
+	uint8_t finishedMask, sensorMask, count, i;
+	unsigned long burstStart, burstLength;
+	boolean burstAllowed, startAllowed;
+	Sensor *sensor;
+
+	// a burst has to fit in the caller's budget, and can't follow the last
+	// one too closely; because these are unsigned values, this works even
+	// for rollovers
+	burstAllowed = (budgetMicros >= burstMicros_);
+	if (burstGapPending_ && (micros() - lastBurstTime_) < DHT_SCHEDULER_BURST_GAP_MICROS) {
+		burstAllowed = false;
+	} else {
+		burstGapPending_ = false;
+	}
+
+	// reads are started one at a time, each once the one before it has
+	// finished, so sensors that come due together end up staggered instead
+	// of all wanting their bursts at once (which would also keep them in
+	// step from then on, since each sample window runs from the start of
+	// the read).  A read is also only started when the budget could fit a
+	// burst: a main loop that can't spare one now probably can't in ~40
+	// milliseconds either, and a read that hasn't been started yet can wait
+	// as long as it needs to without costing a sample window.
+	startAllowed = (budgetMicros >= burstMicros_);
+	for (i = 0; i < numSensors_; i++) {
+		if (sensors_[i]->isReadInProgress()) {
+			startAllowed = false;
+		}
+	}
+
+	finishedMask = 0;
+	for (count = 0, i = nextSensor_; count < numSensors_; count++, i = (i+1 == numSensors_) ? 0 : i+1) {
+		sensor = sensors_[i];
+		sensorMask = 1<<i;
+
+		if (sensor->isBurstDue()) {
+			if (!burstAllowed) {
+				// hold it off until some later tick, but not forever
+				if (!(deferredMask_ & sensorMask)) {
+					deferredMask_ |= sensorMask;
+					deferredSince_[i] = millis();
+				} else if (millis() - deferredSince_[i] > DHT_SCHEDULER_MAX_DEFER_MILLIS) {
+					sensor->cancelRead();
+					deferredMask_ &= ~sensorMask;
+					if (cancelledReads_ < 0xFFFF) {
+						cancelledReads_++;
+					}
+				}
+				continue;
+			}
+			deferredMask_ &= ~sensorMask;
+			burstAllowed = false;
+
+			burstStart = micros();
+			sensor->poll();
+			lastBurstTime_ = micros();
+			burstGapPending_ = true;
+			finishedMask |= sensorMask;
+
+			// if this burst ran long (a slow sensor, say), plan on that from
+			// now on
+			burstLength = lastBurstTime_ - burstStart;
+			if (burstLength > burstMicros_) {
+				burstMicros_ = (burstLength > DHT_MAX_BURST_MICROS) ? DHT_MAX_BURST_MICROS : burstLength;
+			}
+
+			// let the sensors after this one go first next time
+			nextSensor_ = (i+1 == numSensors_) ? 0 : i+1;
+		} else if (sensor->isReadInProgress()) {
+			// outside of the burst, poll() just checks the clock, or sends
+			// the start signal
+			sensor->poll();
+		} else if (startAllowed && sensor->isReadDue()) {
+			sensor->startRead();
+			startAllowed = false;
+		}
+	}
+	return finishedMask;
+}
+
+template <class Sensor> uint16_t DHTBasicScheduler<Sensor>::getBurstMicros() {
+	return burstMicros_;
+}
+
+template <class Sensor> uint16_t DHTBasicScheduler<Sensor>::getCancelledReads() {
+	return cancelledReads_;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef DHT_SENSOR_H
+#define DHT_SENSOR_H
+
+#include "DHT.h"
+
+/***************************************************************************
+ * Compile-time sensor type variant of the DHT class, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ ***************************************************************************/
+
+// DHTSensor works just like DHT, except that the sensor type is part of the
+// type.  Its type policy (see DHTBase) is DHTSensorTraits, so decoding, the
+// minimum sampling delay and the plausibility check used in error correction
+// are all picked at compile time, for reads (including readAll()) as well as
+// the get*() and read*() functions, and there's no sensor type stored in
+// the object at all.  Example:
+//
+//     DHTSensor<DHT_SENSOR_TYPE_DHT22> dht(2);
+//
+// A DHTSensor isn't a DHT, though, so it can't be passed where a DHT is
+// expected.  DHTHistory, DHTLog and DHTBasicScheduler (see DHTScheduler.h)
+// take either; DHTArray only takes DHT objects.
+template <uint8_t TYPE>
+class DHTSensor : public DHTBase<DHTSensorTraits<TYPE> > {
+
+	public:
+
+		typedef DHTSensorTraits<TYPE> Traits;
+
+		DHTSensor(uint8_t pin) : DHTBase<Traits>(pin, Traits()) {}
+
+};
+
+#endif
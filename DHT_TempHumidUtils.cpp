@@ -10,6 +10,85 @@
 
 #include "DHT_TempHumidUtils.h"
 
+// the tables live in flash on AVR; some other cores (ESP8266, ESP32,
+// SAMD...) already have PROGMEM and pgm_read_word() of their own by the time
+// this file is compiled, so only fill in whichever ones are missing
+#if defined(__AVR__)
+ #include "avr/pgmspace.h"
+#endif
+#ifndef PROGMEM
+ #define PROGMEM
+#endif
+#ifndef pgm_read_word
+ #define pgm_read_word(address) (*(const uint16_t*)(address))
+#endif
+
+// the range of the sensors, in tenths of a degree C; the dew point and
+// absolute humidity functions clamp to this, which keeps their fixed point
+// math within 32 bits
+#define MIN_MAGNUS_TENTHS_CELSIUS -400
+#define MAX_MAGNUS_TENTHS_CELSIUS 800
+
+// fixed point values are in units of 1/16384 (Q14) unless noted:
+// 17.62/ln(2), log2(1000), and log2(216.74*6.112/100 * 10), where 216.74 is
+// the grams per cubic meter of a hectopascal of water vapor at 1 kelvin, and
+// 6.112 is the saturation vapor pressure in hectopascals at 0C
+#define MAGNUS_B_OVER_LN2_Q14    416486
+#define LOG2_1000_Q14            163279
+#define LOG2_ABSOLUTE_FACTOR_Q14 115500
+
+// log2(1 + i/32) and 2^(i/32) - 1 for i = 0 to 32, in units of 1/32768;
+// values in between are interpolated, which is accurate to about 2e-4
+static const uint16_t LOG2_TABLE[33] PROGMEM = {
+	0, 1455, 2866, 4236, 5568, 6863, 8124, 9352, 10549, 11716, 12855, 13968, 15055, 16117, 17156, 18173,
+	19168, 20143, 21098, 22034, 22952, 23852, 24736, 25604, 26455, 27292, 28114, 28922, 29717, 30498, 31267, 32024,
+	32768
+};
+static const uint16_t EXP2_TABLE[33] PROGMEM = {
+	0, 718, 1451, 2200, 2966, 3748, 4548, 5365, 6200, 7053, 7925, 8816, 9727, 10657, 11608, 12580,
+	13573, 14588, 15625, 16684, 17767, 18874, 20005, 21160, 22341, 23548, 24781, 26041, 27329, 28645, 29989, 31364,
+	32768
+};
+
+// The batch functions are built from this branch-free version of
+// computeHeatIndexFahrenheit(): it computes every candidate result and then
+// selects between them, which compilers turn into vector blends.  It has to
+// do exactly the same float and double math as the original, in the same
+// order, so that the results are bit-for-bit identical.
+static inline float computeHeatIndexFahrenheitBranchless(float tempFahrenheit, float percentHumidity) {
+	float basicHeatIndex, heatIndex, lowHumidityHeatIndex, highHumidityHeatIndex;
+	float tempFahrenheitSquared, percentHumiditySquared;
+	double lowHumidityRootTerm;
+
+	basicHeatIndex = 1.1*tempFahrenheit + 0.047*percentHumidity - 10.3;
+
+	// as in computeHeatIndexRothfusz(), the squares are exact in double
+	tempFahrenheitSquared = (double)tempFahrenheit * tempFahrenheit;
+	percentHumiditySquared = (double)percentHumidity * percentHumidity;
+	heatIndex = -42.379 +
+			 2.04901523 * tempFahrenheit +
+			10.14333127 * percentHumidity +
+			-0.22475541 * tempFahrenheit * percentHumidity +
+			-0.00683783 * tempFahrenheitSquared +
+			-0.05481717 * percentHumiditySquared +
+			 0.00122874 * tempFahrenheitSquared * percentHumidity +
+			 0.00085282 * tempFahrenheit * percentHumiditySquared +
+			-0.00000199 * tempFahrenheitSquared * percentHumiditySquared;
+
+	// the square root is only used where its argument is positive, but we
+	// clamp it anyway so the unused lanes don't produce NANs
+	lowHumidityRootTerm = (17.0-((tempFahrenheit > 95.0) ? tempFahrenheit-95.0 : 95.0-tempFahrenheit))/17.0;
+	lowHumidityRootTerm = (lowHumidityRootTerm < 0.0) ? 0.0 : lowHumidityRootTerm;
+	lowHumidityHeatIndex = heatIndex + (percentHumidity-13.0)/4.0 * sqrt(lowHumidityRootTerm);
+	highHumidityHeatIndex = heatIndex + (percentHumidity-85.0)/10.0 * (87.0-tempFahrenheit)/5.0;
+
+	// note the use of & rather than &&, which would introduce branches
+	heatIndex = ((percentHumidity > 85.0) & (tempFahrenheit >= 80) & (tempFahrenheit <= 87)) ? highHumidityHeatIndex : heatIndex;
+	heatIndex = ((percentHumidity < 13.0) & (tempFahrenheit >= 80) & (tempFahrenheit <= 112)) ? lowHumidityHeatIndex : heatIndex;
+	heatIndex = (basicHeatIndex <= 79.0) ? basicHeatIndex : heatIndex;
+	return (tempFahrenheit <= 40.0) ? tempFahrenheit : heatIndex;
+}
+
 DHT_TempHumidUtils::DHT_TempHumidUtils() {}
 
 /* static */ float DHT_TempHumidUtils::convertCelsiusToFahrenheit(float tempCelsius) {
@@ -64,7 +143,7 @@ DHT_TempHumidUtils::DHT_TempHumidUtils() {}
 
 	if (percentHumidity < 13.0 && tempFahrenheit >= 80 && tempFahrenheit <= 112) {
 		// an adjustment is made for some very low-humidity conditions
-		return heatIndex + (percentHumidity-13.0)/4.0 * sqrt((17.0-fabs(tempFahrenheit-95.0))/17.0);
+		return heatIndex + (percentHumidity-13.0)/4.0 * sqrt((17.0-((tempFahrenheit > 95.0) ? tempFahrenheit-95.0 : 95.0-tempFahrenheit))/17.0);
 	}
 
 	if (percentHumidity > 85.0 && tempFahrenheit >= 80 && tempFahrenheit <= 87) {
@@ -81,6 +160,24 @@ DHT_TempHumidUtils::DHT_TempHumidUtils() {}
 	return convertFahrenheitToCelsius(computeHeatIndexFahrenheit(convertCelsiusToFahrenheit(tempCelsius), percentHumidity));
 }
 
+/* static */ float DHT_TempHumidUtils::computeDewPointCelsius(float tempCelsius, float percentHumidity) {
+	if (isnan(tempCelsius) || isnan(percentHumidity)) {
+		return NAN;
+	}
+	return computeDewPointTenthsCelsius(roundToTenths(tempCelsius), roundToTenths(percentHumidity)) / 10.0;
+}
+
+/* static */ float DHT_TempHumidUtils::computeDewPointFahrenheit(float tempFahrenheit, float percentHumidity) {
+	return convertCelsiusToFahrenheit(computeDewPointCelsius(convertFahrenheitToCelsius(tempFahrenheit), percentHumidity));
+}
+
+/* static */ float DHT_TempHumidUtils::computeAbsoluteHumidity(float tempCelsius, float percentHumidity) {
+	if (isnan(tempCelsius) || isnan(percentHumidity)) {
+		return NAN;
+	}
+	return computeAbsoluteHumidityTenths(roundToTenths(tempCelsius), roundToTenths(percentHumidity)) / 10.0;
+}
+
 float DHT_TempHumidUtils::computeHeatIndexRothfusz(float tempFahrenheit, float percentHumidity) {
 	// TODO: do I need to declare this private here, or just in the .h?
 	// Adapted from the "Rothfusz regression" equation at:
@@ -98,8 +195,10 @@ float DHT_TempHumidUtils::computeHeatIndexRothfusz(float tempFahrenheit, float p
 	// seems to indicate this equation is inaccurate at very high temperatures
 	// as well, but doesn't go into detail on those limitations.
 
-	float tempFahrenheitSquared = pow(tempFahrenheit, 2);
-	float percentHumiditySquared = pow(percentHumidity, 2);
+	// squaring in double gives exactly what pow(x, 2) would, without the
+	// cost of a general purpose pow()
+	float tempFahrenheitSquared = (double)tempFahrenheit * tempFahrenheit;
+	float percentHumiditySquared = (double)percentHumidity * percentHumidity;
 
 	return -42.379 +
 			 2.04901523 * tempFahrenheit +
@@ -111,3 +210,290 @@ float DHT_TempHumidUtils::computeHeatIndexRothfusz(float tempFahrenheit, float p
 			 0.00085282 * tempFahrenheit * percentHumiditySquared +
 			-0.00000199 * tempFahrenheitSquared * percentHumiditySquared;
 }
+
+
+/* static */ void DHT_TempHumidUtils::convertCelsiusToFahrenheitBatch(const float *tempCelsius, float *tempFahrenheit, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		tempFahrenheit[i] = tempCelsius[i] * 1.8 + 32;
+	}
+}
+
+/* static */ void DHT_TempHumidUtils::convertFahrenheitToCelsiusBatch(const float *tempFahrenheit, float *tempCelsius, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		tempCelsius[i] = (tempFahrenheit[i] - 32) * 0.5555555555555556;
+	}
+}
+
+/* static */ void DHT_TempHumidUtils::computeHeatIndexFahrenheitBatch(const float *tempFahrenheit, const float *percentHumidity, float *heatIndex, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		heatIndex[i] = computeHeatIndexFahrenheitBranchless(tempFahrenheit[i], percentHumidity[i]);
+	}
+}
+
+/* static */ void DHT_TempHumidUtils::computeHeatIndexCelsiusBatch(const float *tempCelsius, const float *percentHumidity, float *heatIndex, size_t count) {
+	float tempFahrenheit;
+
+	for (size_t i = 0; i < count; i++) {
+		tempFahrenheit = tempCelsius[i] * 1.8 + 32;
+		heatIndex[i] = (computeHeatIndexFahrenheitBranchless(tempFahrenheit, percentHumidity[i]) - 32) * 0.5555555555555556;
+	}
+}
+
+
+/* static */ int16_t DHT_TempHumidUtils::convertTenthsCelsiusToTenthsFahrenheit(int16_t tenthsCelsius) {
+	if (tenthsCelsius == DHT_INVALID_TENTHS) {
+		return DHT_INVALID_TENTHS;
+	}
+	// F = C * 9/5 + 32, and 32F is 320 tenths
+	return divideRounded((int32_t)tenthsCelsius * 9, 5) + 320;
+}
+
+/* static */ int16_t DHT_TempHumidUtils::convertTenthsFahrenheitToTenthsCelsius(int16_t tenthsFahrenheit) {
+	if (tenthsFahrenheit == DHT_INVALID_TENTHS) {
+		return DHT_INVALID_TENTHS;
+	}
+	// C = (F - 32) * 5/9, and 32F is 320 tenths
+	return divideRounded(((int32_t)tenthsFahrenheit - 320) * 5, 9);
+}
+
+/* static */ int16_t DHT_TempHumidUtils::computeHeatIndexTenthsFahrenheit(int16_t tenthsFahrenheit, int16_t tenthsPercentHumidity) {
+	// This follows computeHeatIndexFahrenheit() step for step; see there for
+	// the sources and notes.  Intermediate values are kept in hundredths of a
+	// degree, and the result is rounded to tenths at the end.
+	int32_t t = tenthsFahrenheit;
+	int32_t rh = tenthsPercentHumidity;
+	int32_t heatIndex;
+	uint16_t root;
+
+	if (tenthsFahrenheit == DHT_INVALID_TENTHS || tenthsPercentHumidity == DHT_INVALID_TENTHS) {
+		return DHT_INVALID_TENTHS;
+	}
+
+	if (t <= 400) {
+		// presumably it's cold enough that not much humidity is even possible
+		return tenthsFahrenheit;
+	}
+
+	// Start with the basic calculation:
+	//     1.1*tempFahrenheit + 0.047*percentHumidity - 10.3
+	// which in thousandths of a tenth of a degree is:
+	heatIndex = 1100*t + 47*rh - 103000;
+
+	if (heatIndex <= 790000) {
+		// the basic calculation is actually more accurate than the Rothfusz
+		// calculation in this temperature range
+		return divideRounded(heatIndex, 1000);
+	}
+
+	heatIndex = computeHeatIndexRothfuszHundredths(t, rh);
+
+	if (rh < 130 && t >= 800 && t <= 1120) {
+		// an adjustment is made for some very low-humidity conditions:
+		//     (percentHumidity-13.0)/4.0 * sqrt((17.0-fabs(tempFahrenheit-95.0))/17.0)
+		// where the square root is computed in thousandths
+		root = squareRoot((170 - ((t > 950) ? t - 950 : 950 - t)) * 1000000L / 170);
+		heatIndex += divideRounded((rh - 130) * root, 400);
+	} else if (rh > 850 && t >= 800 && t <= 870) {
+		// an adjustment is made for some very high-humidity conditions:
+		//     (percentHumidity-85.0)/10.0 * (87.0-tempFahrenheit)/5.0
+		heatIndex += divideRounded((rh - 850) * (870 - t), 50);
+	}
+
+	heatIndex = divideRounded(heatIndex, 10);
+
+	// the regression gets huge at extreme temperatures and humidities
+	if (heatIndex > 32767) {
+		return 32767;
+	}
+	return heatIndex;
+}
+
+/* static */ int16_t DHT_TempHumidUtils::computeHeatIndexTenthsCelsius(int16_t tenthsCelsius, int16_t tenthsPercentHumidity) {
+	return convertTenthsFahrenheitToTenthsCelsius(computeHeatIndexTenthsFahrenheit(convertTenthsCelsiusToTenthsFahrenheit(tenthsCelsius), tenthsPercentHumidity));
+}
+
+/* static */ int16_t DHT_TempHumidUtils::computeDewPointTenthsCelsius(int16_t tenthsCelsius, int16_t tenthsPercentHumidity) {
+	// The Magnus formula is:
+	//     gamma = ln(RH/100) + b*T/(c+T)
+	//     dewPoint = c*gamma/(b - gamma)
+	// Working in log2 instead of ln, with g = gamma/ln(2), this becomes:
+	//     g = log2(RH) - log2(100) + (b/ln(2))*T/(c+T)
+	//     dewPoint = c*g/(b/ln(2) - g)
+	// where g is computed in Q14, from the humidity in tenths of a percent
+	int32_t g;
+
+	if (tenthsCelsius == DHT_INVALID_TENTHS || tenthsPercentHumidity == DHT_INVALID_TENTHS) {
+		return DHT_INVALID_TENTHS;
+	}
+	if (tenthsPercentHumidity < 1) {
+		tenthsPercentHumidity = 1;
+	} else if (tenthsPercentHumidity > 1000) {
+		tenthsPercentHumidity = 1000;
+	}
+
+	g = log2Fixed(tenthsPercentHumidity) - LOG2_1000_Q14 + computeMagnusExponent(tenthsCelsius);
+
+	// c is 2431.2 tenths of a degree, so the numerator is split up to keep
+	// it within 32 bits
+	return divideRounded(2431*g + g/5, MAGNUS_B_OVER_LN2_Q14 - g);
+}
+
+/* static */ int16_t DHT_TempHumidUtils::computeDewPointTenthsFahrenheit(int16_t tenthsFahrenheit, int16_t tenthsPercentHumidity) {
+	return convertTenthsCelsiusToTenthsFahrenheit(computeDewPointTenthsCelsius(convertTenthsFahrenheitToTenthsCelsius(tenthsFahrenheit), tenthsPercentHumidity));
+}
+
+/* static */ int16_t DHT_TempHumidUtils::computeAbsoluteHumidityTenths(int16_t tenthsCelsius, int16_t tenthsPercentHumidity) {
+	// The absolute humidity in grams per cubic meter is:
+	//     216.74 * vaporPressure / (273.15 + T)
+	// where the vapor pressure comes from the same exponential as the dew
+	// point:
+	//     vaporPressure = RH/100 * 6.112 * exp(b*T/(c+T))
+	// Folding the constant factors into the exponent, in tenths of a g/m^3
+	// (with the humidity in tenths of a percent, and T in tenths of a
+	// degree) this is:
+	//     RH * 2^(magnusExponent + log2(132.47)) / (2731.5 + T)
+	uint32_t power;
+	int32_t t = tenthsCelsius;
+
+	if (tenthsCelsius == DHT_INVALID_TENTHS || tenthsPercentHumidity == DHT_INVALID_TENTHS) {
+		return DHT_INVALID_TENTHS;
+	}
+	if (tenthsPercentHumidity < 0) {
+		tenthsPercentHumidity = 0;
+	} else if (tenthsPercentHumidity > 1000) {
+		tenthsPercentHumidity = 1000;
+	}
+	if (t < MIN_MAGNUS_TENTHS_CELSIUS) {
+		t = MIN_MAGNUS_TENTHS_CELSIUS;
+	} else if (t > MAX_MAGNUS_TENTHS_CELSIUS) {
+		t = MAX_MAGNUS_TENTHS_CELSIUS;
+	}
+
+	// the power is in units of 1/256, and at most ~2.6 million, so the
+	// product with the humidity still fits in 32 unsigned bits
+	power = exp2Fixed(computeMagnusExponent(t) + LOG2_ABSOLUTE_FACTOR_Q14);
+	return ((uint32_t)tenthsPercentHumidity * power + (5463 + 2*t) * 64) / ((5463 + 2*t) * 128);
+}
+
+int32_t DHT_TempHumidUtils::computeMagnusExponent(int16_t tenthsCelsius) {
+	// (b/ln(2))*T/(c+T) in Q14, where c is 2431.2 tenths of a degree; the
+	// numerator and denominator are both scaled by 4 to use the 0.2
+	int32_t t = tenthsCelsius;
+
+	if (t < MIN_MAGNUS_TENTHS_CELSIUS) {
+		t = MIN_MAGNUS_TENTHS_CELSIUS;
+	} else if (t > MAX_MAGNUS_TENTHS_CELSIUS) {
+		t = MAX_MAGNUS_TENTHS_CELSIUS;
+	}
+	return divideRounded(4*MAGNUS_B_OVER_LN2_Q14 * t, 9725 + 4*t);
+}
+
+int32_t DHT_TempHumidUtils::computeHeatIndexRothfuszHundredths(int32_t t, int32_t rh) {
+	// This is the same regression as computeHeatIndexRothfusz(), rearranged
+	// in Horner form so that every step fits in 32 bits:
+	//     A(T) + RH*(B(T) + RH*C(T))
+	// where:
+	//     A(T) = -42.379 + T*(2.04901523 - 0.00683783*T)
+	//     B(T) = 10.14333127 + T*(-0.22475541 + 0.00122874*T)
+	//     C(T) = -0.05481717 + T*(0.00085282 - 0.00000199*T)
+	// with the temperature in tenths of a degree, the humidity in tenths of
+	// a percent, and each part scaled to suit the size of its terms.  This
+	// only holds for temperatures up to 200F, so hotter temperatures are
+	// treated as 200F; the regression is meaningless that far out anyway.
+	int32_t a, b, c;
+
+	if (t > 2000) {
+		t = 2000;
+	}
+
+	// C(T) in units of 1e-7, via an inner term in units of 1e-10
+	c = 8528200 - 1990*t;
+	c = -548172 + (t*(c/10))/1000;
+
+	// B(T) in units of 1e-5, via an inner term in units of 1e-8
+	b = -22475541 + (122874*t)/10;
+	b = 1014333 + (t*(b/100))/100;
+
+	// A(T) in hundredths of a degree, via an inner term in units of 1e-7
+	a = 20490152 - (683783*t)/100;
+	a = -4238 + (t*(a/100))/10000;
+
+	// fold in the humidity terms, ending up in hundredths of a degree
+	b += (rh*c)/1000;
+	return a + (rh*(b/10))/1000;
+}
+
+int32_t DHT_TempHumidUtils::divideRounded(int32_t numerator, int32_t denominator) {
+	// integer division truncates toward zero, so push the numerator half a
+	// denominator away from zero first, to round to the nearest integer
+	if (numerator < 0) {
+		return (numerator - denominator/2) / denominator;
+	}
+	return (numerator + denominator/2) / denominator;
+}
+
+uint16_t DHT_TempHumidUtils::squareRoot(uint32_t value) {
+	// the usual bit-by-bit integer square root, rounded down
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while (bit > value) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+int32_t DHT_TempHumidUtils::log2Fixed(uint16_t value) {
+	// log2 in Q14, of a value of at least 1: the position of the highest set
+	// bit gives the integer part, and the next 5 bits pick the table entries
+	// to interpolate between for the fraction
+	uint8_t exponent = 15;
+	uint16_t low, high;
+
+	while (!(value & 0x8000)) {
+		value <<= 1;
+		exponent--;
+	}
+	low = pgm_read_word(&LOG2_TABLE[(value >> 10) & 31]);
+	high = pgm_read_word(&LOG2_TABLE[((value >> 10) & 31) + 1]);
+	return ((int32_t)exponent << 14) + ((low + (((uint32_t)(high - low) * (value & 0x3FF) + 512) >> 10)) >> 1);
+}
+
+uint32_t DHT_TempHumidUtils::exp2Fixed(int32_t exponent) {
+	// 2 to the power of a Q14 value, in units of 1/256: the integer part of
+	// the exponent is a shift, and the fraction is interpolated from the
+	// table.  The arithmetic shift of a negative exponent rounds it down, as
+	// needed for the fraction to come out positive.
+	int8_t shift = (exponent >> 14) - 7;
+	uint16_t fraction = exponent & 0x3FFF;
+	uint16_t low, high;
+	uint32_t mantissa;
+
+	low = pgm_read_word(&EXP2_TABLE[fraction >> 9]);
+	high = pgm_read_word(&EXP2_TABLE[(fraction >> 9) + 1]);
+	mantissa = 32768 + low + (((uint32_t)(high - low) * (fraction & 0x1FF) + 256) >> 9);
+	if (shift >= 0) {
+		return mantissa << shift;
+	}
+	return (mantissa + (1UL << (-shift-1))) >> -shift;
+}
+
+int16_t DHT_TempHumidUtils::roundToTenths(float value) {
+	// anything too big for tenths in 16 bits is out of range for the sensors
+	// anyway, and gets clamped to their range later
+	if (value > 3000) {
+		return 30000;
+	} else if (value < -3000) {
+		return -30000;
+	}
+	return (value < 0) ? (int16_t)(value*10 - 0.5) : (int16_t)(value*10 + 0.5);
+}
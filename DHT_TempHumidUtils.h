@@ -12,6 +12,12 @@
  ***************************************************************************/
 
 #include "math.h"
+#include "stdint.h"
+#include "stddef.h"
+
+// the integer (tenths) functions return this in place of NAN, and pass it
+// through unchanged if they're given it
+#define DHT_INVALID_TENTHS (-32767-1)
 
 
 class DHT_TempHumidUtils {
@@ -28,6 +34,60 @@ class DHT_TempHumidUtils {
 		// This has the same error as above, converted to +/- 0.7222C
 		static float computeHeatIndexCelsius(float tempCelsius, float percentHumidity);
 
+		// integer versions of the above, working in tenths of a degree and
+		// tenths of a percent, without any floating point math at all, for
+		// boards where pulling in the floating point libraries is too costly.
+		// The temperature conversions are exact, rounded to the nearest tenth
+		// of a degree.  The heat index uses fixed point math, and is within
+		// +/- 0.1F of the floating point version for temperatures up to 200F,
+		// on top of the error of the formula itself noted above.  (The
+		// Celsius version goes through tenths of a degree F, so right where
+		// the formula switches from its basic calculation to the Rothfusz
+		// regression, it can land on the other side of the switch.)
+		static int16_t convertTenthsCelsiusToTenthsFahrenheit(int16_t tenthsCelsius);
+		static int16_t convertTenthsFahrenheitToTenthsCelsius(int16_t tenthsFahrenheit);
+		static int16_t computeHeatIndexTenthsFahrenheit(int16_t tenthsFahrenheit, int16_t tenthsPercentHumidity);
+		static int16_t computeHeatIndexTenthsCelsius(int16_t tenthsCelsius, int16_t tenthsPercentHumidity);
+
+		// dew point (via the Magnus formula, with Sonntag's constants
+		// b = 17.62 and c = 243.12C) and absolute humidity (in grams of water
+		// per cubic meter of air, from the same vapor pressure).  None of
+		// these use the floating point libraries, or any floating point math
+		// at all in the tenths versions: the logarithm and exponential are
+		// read from small PROGMEM tables of log2 and exp2 and interpolated,
+		// and everything else is 32-bit integer math, so all of them together
+		// take well under a millisecond on an 8-bit AVR.  The float versions
+		// round their inputs to tenths and use the same code.
+		//
+		// Against the exact formulas, over the sensors' whole range (-40C to
+		// 80C, and 0% to 100% humidity), the tenths versions are within
+		// 0.06C for the dew point (0.22F for the Fahrenheit version, which
+		// goes through tenths of a degree C), and 0.07 g/m^3 for absolute
+		// humidity; that's barely more than the 0.05 that rounding to tenths
+		// costs on its own.  The float versions add the rounding of their
+		// inputs on top of that.  Temperatures outside that range are treated
+		// as the nearest end of it.  Below 0.1% humidity the dew point is
+		// that of 0.1%, since there's no dew point for completely dry air.
+		static float computeDewPointCelsius(float tempCelsius, float percentHumidity);
+		static float computeDewPointFahrenheit(float tempFahrenheit, float percentHumidity);
+		static float computeAbsoluteHumidity(float tempCelsius, float percentHumidity);
+		static int16_t computeDewPointTenthsCelsius(int16_t tenthsCelsius, int16_t tenthsPercentHumidity);
+		static int16_t computeDewPointTenthsFahrenheit(int16_t tenthsFahrenheit, int16_t tenthsPercentHumidity);
+		static int16_t computeAbsoluteHumidityTenths(int16_t tenthsCelsius, int16_t tenthsPercentHumidity);
+
+		// batched versions of the float functions, for crunching through
+		// lots of stored readings at once (on a gateway or other host, say).
+		// Each writes count results to the output array, bit-for-bit the same
+		// as calling the single-value function on each element, but they are
+		// written without any data-dependent branches so the compiler can
+		// vectorize them.  With gcc or clang, build with -O3, plus
+		// -fno-math-errno -fno-trapping-math so that sqrt() and the selects
+		// can be vectorized too (neither flag changes any results)
+		static void convertCelsiusToFahrenheitBatch(const float *tempCelsius, float *tempFahrenheit, size_t count);
+		static void convertFahrenheitToCelsiusBatch(const float *tempFahrenheit, float *tempCelsius, size_t count);
+		static void computeHeatIndexFahrenheitBatch(const float *tempFahrenheit, const float *percentHumidity, float *heatIndex, size_t count);
+		static void computeHeatIndexCelsiusBatch(const float *tempCelsius, const float *percentHumidity, float *heatIndex, size_t count);
+
 
 	private:
 
@@ -35,6 +95,17 @@ class DHT_TempHumidUtils {
 
 		// used by the public computeHeadIndex functions
 		static float computeHeatIndexRothfusz(float tempFahrenheit, float percentHumidity);
+		static int32_t computeHeatIndexRothfuszHundredths(int32_t tenthsFahrenheit, int32_t tenthsPercentHumidity);
+
+		// used by the dew point and absolute humidity functions
+		static int32_t computeMagnusExponent(int16_t tenthsCelsius);
+
+		// integer helpers
+		static int32_t divideRounded(int32_t numerator, int32_t denominator);
+		static uint16_t squareRoot(uint32_t value);
+		static int32_t log2Fixed(uint16_t value);
+		static uint32_t exp2Fixed(int32_t exponent);
+		static int16_t roundToTenths(float value);
 
 };
 
@@ -0,0 +1,54 @@
+// Example sketch showing how to read a DHT sensor without blocking the main
+// loop during the start delay and start signal
+// Written by Joe Ibershoff, released under MIT license
+
+#include "DHT.h"
+
+#define DHTPIN 2		 // what pin we're connected to
+#define DHTTYPE DHT_SENSOR_TYPE_DHT22
+
+DHT dht(DHTPIN, DHTTYPE);
+
+void setup() {
+	Serial.begin(9600);
+	Serial.println("DHTxx non-blocking test!");
+
+	dht.begin();
+}
+
+boolean reading = false;
+
+void loop() {
+	uint8_t status;
+
+	// startRead() only starts a new read once the minimum sampling delay has
+	// passed, so it's safe to call it every time through the loop
+	if (!reading) {
+		reading = dht.startRead();
+		return;
+	}
+
+	status = dht.poll();
+	if (status == DHT_READ_IN_PROGRESS) {
+		// nothing new yet; go do something else useful
+		return;
+	}
+	reading = false;
+
+	if (status == DHT_READ_DISCONNECTED) {
+		// reads will be retried less and less often until it's back
+		Serial.println("DHT sensor seems to be disconnected!");
+		return;
+	}
+	if (status != DHT_READ_OK) {
+		Serial.println("Failed to read from DHT sensor!");
+		return;
+	}
+
+	Serial.print("Humidity: ");
+	Serial.print(dht.getPercentHumidity());
+	Serial.print(" %\t");
+	Serial.print("Temperature: ");
+	Serial.print(dht.getTemperatureCelsius());
+	Serial.println(" *C");
+}
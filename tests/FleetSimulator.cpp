@@ -0,0 +1,309 @@
+// Simulates a fleet of sensor nodes, each a DHT object with a mock sensor in
+// a mock environment of its own: its own clock, and its own trajectory of
+// temperature and humidity (a sine wave around a base value, with some
+// nodes' sensors failing now and then).  The nodes are read on a pool of
+// threads, which steal work from each other, and the whole fleet is run
+// once for each number of threads up to the number of cores, to see how the
+// throughput scales.
+//
+// A task is a few reads of a single node.  Each thread keeps a queue of
+// tasks; it takes the newest task from its own queue (a node it just read
+// is the one most likely to still be in its cache), and when that's empty,
+// steals the oldest task from another thread's queue.  A node that still
+// has reads to do goes back on the queue of the thread that just read it.
+//
+// Because every node has its own clock, the readings don't depend on which
+// thread ran which node, or in what order; each run checks that it got
+// exactly the same readings as the first.
+//
+// usage: fleet_sim.out [nodes] [virtual seconds] [max threads]
+//
+// Written by Joe Ibershoff, released under MIT license
+
+#include "WProgram.h"
+#include "DHT.h"
+#include "math.h"
+#include "pthread.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+#include "unistd.h"
+
+#define DEFAULT_NUM_NODES 500
+#define DEFAULT_VIRTUAL_SECONDS 20
+#define MAX_THREADS 64
+#define READS_PER_TASK 2
+#define SENSOR_PIN 2
+
+
+struct Node {
+	MockEnvironment *environment;
+	DHT *dht;
+	uint8_t type;
+
+	float baseCelsius, swingCelsius;
+	float baseHumidity, swingHumidity;
+	unsigned long periodMillis;
+	unsigned int failEvery;
+
+	unsigned int readsLeft;
+	unsigned long reads, frames, mismatches;
+	unsigned long checksum;
+};
+
+struct WorkQueue {
+	pthread_mutex_t lock;
+	uint32_t *tasks;
+	uint32_t head, size;
+};
+
+struct Fleet {
+	Node *nodes;
+	uint32_t numNodes;
+	WorkQueue queues[MAX_THREADS];
+	int numThreads;
+	uint32_t nodesLeft;
+	unsigned long steals;
+};
+
+struct Worker {
+	Fleet *fleet;
+	int index;
+};
+
+static double nowSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+// each queue is a ring with room for every node, since a node is only ever
+// on one queue at a time
+static void pushTask(Fleet &fleet, int queueIndex, uint32_t task) {
+	WorkQueue &queue = fleet.queues[queueIndex];
+
+	pthread_mutex_lock(&queue.lock);
+	queue.tasks[(queue.head + queue.size++) % fleet.numNodes] = task;
+	pthread_mutex_unlock(&queue.lock);
+}
+
+// the newest task from the thread's own queue, or the oldest from another's
+static boolean takeTask(Fleet &fleet, int queueIndex, uint32_t &task) {
+	WorkQueue *queue = &fleet.queues[queueIndex];
+	boolean found = false;
+	int i;
+
+	pthread_mutex_lock(&queue->lock);
+	if (queue->size > 0) {
+		task = queue->tasks[(queue->head + --queue->size) % fleet.numNodes];
+		found = true;
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	for (i = 1; !found && i < fleet.numThreads; i++) {
+		queue = &fleet.queues[(queueIndex + i) % fleet.numThreads];
+		pthread_mutex_lock(&queue->lock);
+		if (queue->size > 0) {
+			task = queue->tasks[queue->head];
+			queue->head = (queue->head + 1) % fleet.numNodes;
+			queue->size--;
+			found = true;
+			__atomic_fetch_add(&fleet.steals, 1, __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&queue->lock);
+	}
+	return found;
+}
+
+
+static void setUpNode(Node &node, uint32_t index, unsigned int numReads) {
+	// every node gets a different, but repeatable, trajectory
+	srand(index * 7919 + 1);
+	node.type = (index % 5 == 0) ? DHT_SENSOR_TYPE_DHT11 : DHT_SENSOR_TYPE_DHT22;
+	node.baseCelsius = 10 + (rand() % 200) / 10.0;
+	node.swingCelsius = (rand() % 100) / 10.0;
+	node.baseHumidity = 30 + (rand() % 400) / 10.0;
+	node.swingHumidity = (rand() % 200) / 10.0;
+	node.periodMillis = 10000 + rand() % 50000;
+	node.failEvery = (index % 7 == 0) ? 3 + rand() % 5 : 0;
+
+	node.readsLeft = numReads;
+	node.reads = node.frames = node.mismatches = node.checksum = 0;
+
+	node.environment = createMockEnvironment();
+	setMockEnvironment(node.environment);
+	node.dht = new DHT(SENSOR_PIN, node.type);
+	node.dht->begin();
+	setMockEnvironment(NULL);
+}
+
+static void tearDownNode(Node &node) {
+	delete node.dht;
+	destroyMockEnvironment(node.environment);
+}
+
+// a few reads of one node, in its own environment
+static void runTask(Node &node) {
+	float phase, celsius, humidity;
+	int16_t expectedTemperature, expectedHumidity;
+	boolean faulty;
+	unsigned int i;
+
+	setMockEnvironment(node.environment);
+	for (i = 0; i < READS_PER_TASK && node.readsLeft > 0; i++, node.readsLeft--) {
+		delay(node.dht->getMinSampleDelayMillis());
+
+		phase = 2 * M_PI * (millis() % node.periodMillis) / node.periodMillis;
+		celsius = node.baseCelsius + node.swingCelsius * sin(phase);
+		humidity = node.baseHumidity + node.swingHumidity * cos(phase);
+		setSensorValues(SENSOR_PIN, celsius, humidity, (node.type == DHT_SENSOR_TYPE_DHT11) ? 8 : 16);
+		faulty = node.failEvery && node.reads % node.failEvery == 0;
+		if (faulty) {
+			setSensorFault(SENSOR_PIN, MOCK_FAULT_NO_RESPONSE);
+		}
+
+		node.reads++;
+		if (!node.dht->readSensorData()) {
+			if (faulty) {
+				setSensorFault(SENSOR_PIN, MOCK_FAULT_NONE);
+			}
+			continue;
+		}
+		node.frames++;
+
+		// the values the mock sensor encodes
+		if (node.type == DHT_SENSOR_TYPE_DHT11) {
+			expectedTemperature = (int16_t)round(celsius) * 10;
+			expectedHumidity = (int16_t)round(humidity) * 10;
+		} else {
+			expectedTemperature = (int16_t)round(celsius * 10.0);
+			expectedHumidity = (int16_t)round(humidity * 10.0);
+		}
+		if (node.dht->getTemperatureTenthsC() != expectedTemperature || node.dht->getHumidityTenths() != expectedHumidity) {
+			node.mismatches++;
+		}
+		node.checksum = node.checksum * 31 + (uint16_t)node.dht->getTemperatureTenthsC() * 1009 + node.dht->getHumidityTenths();
+	}
+	setMockEnvironment(NULL);
+}
+
+static void* runWorker(void *arg) {
+	Worker &worker = *(Worker*)arg;
+	Fleet &fleet = *worker.fleet;
+	uint32_t task;
+
+	while (__atomic_load_n(&fleet.nodesLeft, __ATOMIC_ACQUIRE) > 0) {
+		if (!takeTask(fleet, worker.index, task)) {
+			// everything left is being run by other threads right now
+			sched_yield();
+			continue;
+		}
+		runTask(fleet.nodes[task]);
+		if (fleet.nodes[task].readsLeft > 0) {
+			pushTask(fleet, worker.index, task);
+		} else {
+			__atomic_fetch_sub(&fleet.nodesLeft, 1, __ATOMIC_RELEASE);
+		}
+	}
+	return NULL;
+}
+
+// runs the whole fleet on numThreads threads; returns the host seconds taken
+static double runFleet(uint32_t numNodes, unsigned int numReads, int numThreads, unsigned long &frames, unsigned long &mismatches,
+		unsigned long &checksum, unsigned long &steals) {
+	Fleet fleet;
+	Worker workers[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+	double start, seconds;
+	uint32_t i;
+	int t;
+
+	fleet.numNodes = numNodes;
+	fleet.numThreads = numThreads;
+	fleet.nodesLeft = numNodes;
+	fleet.steals = 0;
+	fleet.nodes = new Node[numNodes];
+	for (i = 0; i < numNodes; i++) {
+		setUpNode(fleet.nodes[i], i, numReads);
+	}
+
+	// deal the nodes out in contiguous blocks, so any difference in cost
+	// between the blocks has to be evened out by stealing
+	for (t = 0; t < numThreads; t++) {
+		pthread_mutex_init(&fleet.queues[t].lock, NULL);
+		fleet.queues[t].tasks = new uint32_t[numNodes];
+		fleet.queues[t].head = fleet.queues[t].size = 0;
+	}
+	for (i = 0; i < numNodes; i++) {
+		pushTask(fleet, (uint64_t)i * numThreads / numNodes, i);
+	}
+
+	start = nowSeconds();
+	for (t = 0; t < numThreads; t++) {
+		workers[t].fleet = &fleet;
+		workers[t].index = t;
+		pthread_create(&threads[t], NULL, runWorker, &workers[t]);
+	}
+	for (t = 0; t < numThreads; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	seconds = nowSeconds() - start;
+
+	frames = mismatches = checksum = 0;
+	for (i = 0; i < numNodes; i++) {
+		frames += fleet.nodes[i].frames;
+		mismatches += fleet.nodes[i].mismatches;
+		checksum = checksum * 31 + fleet.nodes[i].checksum;
+		tearDownNode(fleet.nodes[i]);
+	}
+	steals = fleet.steals;
+
+	for (t = 0; t < numThreads; t++) {
+		pthread_mutex_destroy(&fleet.queues[t].lock);
+		delete[] fleet.queues[t].tasks;
+	}
+	delete[] fleet.nodes;
+	return seconds;
+}
+
+int main(int argc, char** argv) {
+	uint32_t numNodes = (argc > 1) ? atoi(argv[1]) : DEFAULT_NUM_NODES;
+	unsigned long virtualSeconds = (argc > 2) ? atoi(argv[2]) : DEFAULT_VIRTUAL_SECONDS;
+	int maxThreads = (argc > 3) ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned long frames, mismatches, checksum, steals, firstFrames = 0, firstChecksum = 0;
+	double seconds, firstRate = 0;
+	unsigned int numReads;
+	int numThreads;
+
+	if (numNodes < 1 || maxThreads < 1) {
+		fprintf(stderr, "usage: fleet_sim.out [nodes] [virtual seconds] [max threads]\n");
+		return 1;
+	}
+	if (maxThreads > MAX_THREADS) {
+		maxThreads = MAX_THREADS;
+	}
+
+	// DHT22s can be read every 2 seconds, and DHT11s every second; to keep
+	// things simple, every node gets the same number of reads
+	numReads = virtualSeconds / 2;
+
+	for (numThreads = 1; ; numThreads = (numThreads*2 > maxThreads) ? maxThreads : numThreads*2) {
+		seconds = runFleet(numNodes, numReads, numThreads, frames, mismatches, checksum, steals);
+		if (numThreads == 1) {
+			firstFrames = frames;
+			firstChecksum = checksum;
+			firstRate = frames / seconds;
+		}
+		printf("{\"threads\":%d,\"nodes\":%u,\"reads\":%lu,\"frames\":%lu,\"mismatches\":%lu,\"steals\":%lu,"
+			"\"seconds\":%.3f,\"frames_per_s\":%.0f,\"speedup\":%.2f,\"same_as_1_thread\":%s}\n",
+			numThreads, numNodes, (unsigned long)numNodes * numReads, frames, mismatches, steals,
+			seconds, frames / seconds, frames / seconds / firstRate,
+			(frames == firstFrames && checksum == firstChecksum) ? "true" : "false");
+		fflush(stdout);
+		if (numThreads == maxThreads) {
+			break;
+		}
+	}
+	return 0;
+}
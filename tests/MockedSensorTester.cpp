@@ -6,10 +6,33 @@
 #include "math.h"
 #include "WProgram.h"
 #include "DHT.h"
+#include "DHTArray.h"
+#include "DHTFast.h"
+#include "DHTAsync.h"
+#include "DHTHistory.h"
+#include "DHTLog.h"
+#include "DHTScheduler.h"
+#include "DHTSensor.h"
 #include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "pthread.h"
 
 
-void testCode(float celsius_, float humidity_, DHT &dht, unsigned short valueWidth) {
+// how many checks have failed; main() returns an error if any have, so a
+// regression fails the test run rather than just showing up in the output
+static unsigned int failures_;
+
+// counts a failed check, and passes its result along
+static boolean check(boolean passed) {
+	if (!passed) {
+		failures_++;
+	}
+	return passed;
+}
+
+template <class Sensor>
+void testCode(float celsius_, float humidity_, Sensor &dht, unsigned short valueWidth) {
 	setSensorValues(celsius_, humidity_, valueWidth);
 
 	float humidity = dht.readPercentHumidity();
@@ -17,7 +40,7 @@ void testCode(float celsius_, float humidity_, DHT &dht, unsigned short valueWid
 	float temperatureF = dht.readTemperatureFahrenheit();
 
 	// Check if any reads failed
-	if (isnan(humidity) || isnan(temperatureC) || isnan(temperatureF)) {
+	if (!check(!isnan(humidity) && !isnan(temperatureC) && !isnan(temperatureF))) {
 		printf("Failed to read from DHT sensor!\n");
 		return;
 	}
@@ -27,8 +50,816 @@ void testCode(float celsius_, float humidity_, DHT &dht, unsigned short valueWid
 	float heatIndexC = dht.readHeatIndexCelsius();
 
 	printf("Humidity: %4.1f%%     Temperature: %5.1f*C / %5.1f*F     Heat index: %5.1f*C / %5.1f*F\n", humidity, temperatureC, temperatureF, heatIndexC, heatIndexF);
+
+	// the integer versions should agree, give or take rounding
+	printf("Humidity: %4d     Temperature: %5d    / %5d        Heat index: %5d    / %5d      (tenths)\n", dht.getHumidityTenths(), dht.getTemperatureTenthsC(), dht.getTemperatureTenthsF(), dht.readHeatIndexTenthsC(), dht.readHeatIndexTenthsF());
+}
+
+void testNonBlocking(float celsius_, float humidity_, DHT &dht, unsigned short valueWidth) {
+	unsigned long polls = 0;
+	uint8_t status;
+
+	setSensorValues(celsius_, humidity_, valueWidth);
+
+	if (!check(dht.startRead())) {
+		printf("Non-blocking read refused to start!\n");
+		return;
+	}
+	while ((status = dht.poll()) == DHT_READ_IN_PROGRESS) {
+		// a real sketch would do other work here
+		polls++;
+		delayMicroseconds(100);
+	}
+
+	if (!check(status == DHT_READ_OK)) {
+		printf("Non-blocking read failed with status %d!\n", status);
+		return;
+	}
+
+	printf("Humidity: %4.1f%%     Temperature: %5.1f*C     (non-blocking, %lu polls)\n", dht.getPercentHumidity(), dht.getTemperatureCelsius(), polls);
+}
+
+void testArray(float celsius_, float humidity_, DHTArray &array, DHT **sensors, const uint8_t *pins, uint8_t numSensors, unsigned short valueWidth) {
+	int16_t validMask;
+
+	// give each sensor slightly different values, to be sure none of them get
+	// mixed up
+	for (uint8_t i = 0; i < numSensors; i++) {
+		setSensorValues(pins[i], celsius_ + i, humidity_ - i, valueWidth);
+	}
+
+	// while the array has the sensors, each of them should say so
+	if (!check(array.startRead())) {
+		printf("Array read refused to start!\n");
+		return;
+	}
+	do {
+		validMask = array.poll();
+		for (uint8_t i = 0; i < numSensors; i++) {
+			if (!check(sensors[i]->isReadInProgress() == (validMask == DHT_ARRAY_READ_IN_PROGRESS) &&
+					(sensors[i]->poll() == DHT_READ_IN_PROGRESS) == (validMask == DHT_ARRAY_READ_IN_PROGRESS))) {
+				printf("Array sensor %d disagrees with the array about its read!\n", i);
+			}
+		}
+	} while (validMask == DHT_ARRAY_READ_IN_PROGRESS);
+
+	for (uint8_t i = 0; i < numSensors; i++) {
+		if (!check(validMask & (1<<i))) {
+			printf("Failed to read from DHT sensor %d in array!\n", i);
+			continue;
+		}
+		printf("Humidity: %4.1f%%     Temperature: %5.1f*C     (array sensor %d)\n", sensors[i]->getPercentHumidity(), sensors[i]->getTemperatureCelsius(), i);
+	}
 }
 
+void testFault(DHT &dht, uint8_t pin, const char *description, int fault, int position, long extraMicros) {
+	uint8_t status;
+
+	// the fault only lasts for this one read
+	setSensorFault(pin, fault, position, extraMicros, 1);
+
+	if (!check(dht.startRead())) {
+		printf("Read with %s refused to start!\n", description);
+		return;
+	}
+	while ((status = dht.poll()) == DHT_READ_IN_PROGRESS) {
+		delayMicroseconds(100);
+	}
+	printf("Status %d with %s%s\n", status, description, dht.wasCorrected() ? " (corrected)" : "");
+}
+
+void testDisconnect(DHT &dht, uint8_t pin) {
+	uint64_t start;
+	boolean started;
+	uint8_t status;
+
+	// the sensor is unplugged for a while; reads should start failing fast,
+	// with longer and longer gaps between probes
+	setSensorFault(pin, MOCK_FAULT_NO_RESPONSE);
+	for (int i = 0; i < 24; i++) {
+		if (i == 16) {
+			// ...and then it's plugged back in
+			setSensorFault(pin, MOCK_FAULT_NONE);
+		}
+		start = getMockTimeMicros();
+		started = dht.startRead();
+		while ((status = dht.poll()) == DHT_READ_IN_PROGRESS) {
+			delayMicroseconds(100);
+		}
+		if (started) {
+			printf("Second %2d: status %d after %5.1fms%s\n", i*2, status, (getMockTimeMicros() - start) / 1000.0, dht.isDisconnected() ? " (disconnected)" : "");
+		}
+		delay(2000);
+	}
+}
+
+void testRetries(DHT &dht, uint8_t pin, const char *description, int fault, int numReads) {
+	unsigned long responses = getSensorResponseCount(pin);
+	uint64_t start = getMockTimeMicros();
+	boolean valid;
+
+	setSensorFault(pin, fault, 20, 0, numReads);
+	valid = dht.readSensorData();
+	printf("%s: %s after %4.1fs and %lu tries", description, valid ? "valid" : "invalid",
+		(getMockTimeMicros() - start) / 1e6, getSensorResponseCount(pin) - responses);
+	if (valid) {
+		printf(", humidity %4.1f%%, temperature %5.1f*C, %lums old", dht.getPercentHumidity(), dht.getTemperatureCelsius(), dht.getValueAgeMillis());
+	}
+	printf("\n");
+}
+
+void testHistory(DHT &dht, uint8_t pin) {
+	static const float temperatures[] = {21.0, 22.5, 20.1, 24.8, 23.3, 19.6, 25.2, 22.0};
+	DHTHistory<5> history;
+	int16_t value, minTemp, maxTemp;
+	int32_t sum;
+
+	if (!check(history.getTimestamp(0) == 0)) {
+		printf("History gave a timestamp while empty!\n");
+	}
+
+	for (uint8_t i = 0; i < sizeof(temperatures)/sizeof(temperatures[0]); i++) {
+		setSensorValues(pin, temperatures[i], 40.0 + i, 16);
+		delay(2000);
+		dht.readSensorData();
+		history.add(dht);
+		// reading from the cache shouldn't add the same value again
+		dht.readSensorData();
+		if (!check(!history.add(dht))) {
+			printf("History added a cached value!\n");
+		}
+
+		// check the rolling statistics against a plain scan of the readings
+		minTemp = maxTemp = history.getTemperatureTenthsC(0);
+		sum = 0;
+		for (uint8_t age = 0; age < history.size(); age++) {
+			value = history.getTemperatureTenthsC(age);
+			minTemp = (value < minTemp) ? value : minTemp;
+			maxTemp = (value > maxTemp) ? value : maxTemp;
+			sum += value;
+		}
+		if (!check(minTemp == history.getMinTemperatureTenthsC() && maxTemp == history.getMaxTemperatureTenthsC() &&
+				abs(sum - history.getMeanTemperatureTenthsC() * history.size()) <= history.size())) {
+			printf("History statistics don't match its readings!\n");
+		}
+
+		// the timestamps should run back from the newest over the span, and
+		// stop where the readings do
+		if (!check(history.getTimestamp(0) == dht.getValueTimestamp() &&
+				history.getTimestamp(history.size()-1) == dht.getValueTimestamp() - history.getSpanMillis() &&
+				history.getTimestamp(history.size()) == 0 && history.getTimestamp(255) == 0)) {
+			printf("History timestamps don't match its readings!\n");
+		}
+
+		printf("History of %d: temperature min %3d max %3d mean %3d EMA %3d, humidity min %3d max %3d mean %3d, over %5lums\n",
+			history.size(), history.getMinTemperatureTenthsC(), history.getMaxTemperatureTenthsC(),
+			history.getMeanTemperatureTenthsC(), history.getEMATemperatureTenthsC(), history.getMinHumidityTenths(),
+			history.getMaxHumidityTenths(), history.getMeanHumidityTenths(), history.getSpanMillis());
+	}
+}
+
+void testScheduler(DHTScheduler &scheduler, DHT **sensors, uint8_t numSensors, unsigned long shortBudget, unsigned long longEvery, unsigned long seconds,
+		unsigned int minReads=0) {
+	unsigned int reads[DHT_SCHEDULER_MAX_SENSORS] = {0}, good[DHT_SCHEDULER_MAX_SENSORS] = {0};
+	uint64_t end, start, elapsed, lastBurst = 0, minGap = ~0ULL, overBudget = 0;
+	unsigned long budget, ticks = 0, cancelled = scheduler.getCancelledReads();
+	uint8_t finished;
+
+	// most ticks only have a short budget, but every so often (if ever) one
+	// has plenty
+	end = getMockTimeMicros() + seconds*1000000ULL;
+	while (getMockTimeMicros() < end) {
+		budget = (longEvery && ticks++ % longEvery == 0) ? 20000 : shortBudget;
+		start = getMockTimeMicros();
+		finished = scheduler.tick(budget);
+		elapsed = getMockTimeMicros() - start;
+		if (elapsed > budget && elapsed - budget > overBudget) {
+			overBudget = elapsed - budget;
+		}
+		if (finished) {
+			if (lastBurst && start - lastBurst < minGap) {
+				minGap = start - lastBurst;
+			}
+			lastBurst = getMockTimeMicros();
+		}
+		for (uint8_t i = 0; i < numSensors; i++) {
+			if (finished & (1<<i)) {
+				reads[i]++;
+				if (sensors[i]->poll() == DHT_READ_OK) {
+					good[i]++;
+				}
+			}
+		}
+		delayMicroseconds(500);
+	}
+
+	printf("Scheduler with %4luus budgets for %lus:", shortBudget, seconds);
+	for (uint8_t i = 0; i < numSensors; i++) {
+		printf(" sensor %d %u/%u good,", i, good[i], reads[i]);
+	}
+	printf(" %lu cancelled, ", scheduler.getCancelledReads() - cancelled);
+	if (minGap != ~0ULL) {
+		printf("bursts at least %4.1fms apart, ", minGap / 1000.0);
+	}
+	printf("%s\n", check(!overBudget) ? "never over budget" : "over budget!");
+	for (uint8_t i = 0; i < numSensors; i++) {
+		if (!check(reads[i] >= minReads)) {
+			printf("Scheduler only read sensor %d %u times, rather than at least %u!\n", i, reads[i], minReads);
+		}
+	}
+}
+
+// decode a finished log block, and compare it against what went into it
+static unsigned int checkLogBlock(const uint8_t *block, const uint32_t *times, const uint8_t *statuses,
+		const int16_t *temperatures, const int16_t *humidities) {
+	uint32_t decodedTimes[DHT_LOG_BLOCK_SIZE];
+	uint8_t decodedFlags[DHT_LOG_BLOCK_SIZE];
+	int16_t decodedTemperatures[DHT_LOG_BLOCK_SIZE], decodedHumidities[DHT_LOG_BLOCK_SIZE];
+	int32_t numRecords;
+	unsigned int mismatches = 0;
+
+	numRecords = DHTLog::decodeBlock(block, decodedTimes, decodedFlags, decodedTemperatures, decodedHumidities);
+	if (!DHTLog::isValidBlock(block, DHT_LOG_BLOCK_SIZE) || numRecords != DHTLog::getBlockNumRecords(block)) {
+		return 1;
+	}
+	for (int32_t i = 0; i < numRecords; i++) {
+		if (decodedTimes[i] != times[i] || (decodedFlags[i] & DHT_LOG_STATUS_MASK) != statuses[i] ||
+				decodedTemperatures[i] != temperatures[i] || decodedHumidities[i] != humidities[i]) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+void testLog(DHT &dht, uint8_t pin, unsigned int numReads) {
+	static const int faults[] = {MOCK_FAULT_NONE, MOCK_FAULT_NONE, MOCK_FAULT_NONE, MOCK_FAULT_NO_RESPONSE, MOCK_FAULT_NONE, MOCK_FAULT_CORRUPT_BIT};
+	uint32_t times[DHT_LOG_BLOCK_SIZE];
+	uint8_t statuses[DHT_LOG_BLOCK_SIZE];
+	int16_t temperatures[DHT_LOG_BLOCK_SIZE], humidities[DHT_LOG_BLOCK_SIZE];
+	unsigned int blocks = 0, mismatches = 0, records = 0;
+	uint16_t count;
+	DHTLog log(3);
+
+	for (unsigned int i = 0; i < numReads; i++) {
+		// slowly drifting values, which cross below freezing partway through
+		setSensorValues(pin, 2.0 - i*0.1, 50.0 + (i%7)*0.3, 16);
+		setSensorFault(pin, faults[i % 6], 20, 0, 1);
+		delay(2000);
+		dht.readSensorData();
+
+		if (!log.add(dht)) {
+			mismatches += checkLogBlock(log.getBlock(), times, statuses, temperatures, humidities);
+			blocks++;
+			log.clear();
+			log.add(dht);
+		}
+		count = log.getNumRecords() - 1;
+		times[count] = millis();
+		statuses[count] = dht.poll();
+		temperatures[count] = dht.getTemperatureTenthsC();
+		humidities[count] = dht.getHumidityTenths();
+		records++;
+	}
+	mismatches += checkLogBlock(log.getBlock(), times, statuses, temperatures, humidities);
+	blocks++;
+
+	check(mismatches == 0);
+	printf("Log of %u reads in %u blocks of %d bytes (%.1f bytes per read), %u mismatches\n",
+		records, blocks, DHT_LOG_BLOCK_SIZE, (double)blocks*DHT_LOG_BLOCK_SIZE / records, mismatches);
+
+	// a block whose header claims more record bytes than its records fill
+	// is damaged, even though every record decodes
+	uint8_t damaged[DHT_LOG_BLOCK_SIZE];
+	uint32_t decodedTimes[DHT_LOG_BLOCK_SIZE];
+	uint8_t decodedFlags[DHT_LOG_BLOCK_SIZE];
+	memcpy(damaged, log.getBlock(), DHT_LOG_BLOCK_SIZE);
+	damaged[6]++;
+	printf("Log: a block with bytes after its last record is %s\n",
+		check(DHTLog::decodeBlock(damaged, decodedTimes, decodedFlags, temperatures, humidities) == -1) ? "rejected" : "accepted!");
+
+	// ... as is one with a damaged record, which the CRC catches
+	memcpy(damaged, log.getBlock(), DHT_LOG_BLOCK_SIZE);
+	damaged[DHT_LOG_HEADER_SIZE + 1] ^= 0x01;
+	printf("Log: a block with a damaged record is %s\n",
+		check(DHTLog::isValidBlock(log.getBlock(), DHT_LOG_BLOCK_SIZE) && !DHTLog::isValidBlock(damaged, DHT_LOG_BLOCK_SIZE)) ?
+		"rejected" : "accepted!");
+}
+
+void testFrame(DHT &dht, uint8_t pin, float celsius_, float humidity_, unsigned short valueWidth) {
+	DHTFrame frame;
+
+	setSensorValues(pin, celsius_, humidity_, valueWidth);
+	delay(2000);
+	if (!check(dht.readSensorData(frame))) {
+		printf("Failed to read a frame!\n");
+		return;
+	}
+	// a frame should decode the same as the sensor it came from
+	printf("Frame: humidity %4.1f%%, temperature %5.1f*C%s\n", frame.getPercentHumidity(), frame.getTemperatureCelsius(),
+		check(frame.getTemperatureTenthsC() == dht.getTemperatureTenthsC() && frame.getHumidityTenths() == dht.getHumidityTenths()) ?
+		"" : " (doesn't match the sensor!)");
+}
+
+void testReadAll(DHT &dht, uint8_t pin, float celsius_, float humidity_) {
+	DHTReading reading;
+	uint16_t generation;
+	boolean matches;
+
+	setSensorValues(pin, celsius_, humidity_, 16);
+	delay(2000);
+	dht.readAll(reading);
+	generation = reading.getGeneration();
+	printf("Read all: humidity %4.1f%%, temperature %5.1f*C / %5.1f*F, heat index %5.1f*C / %5.1f*F, dew point %5.1f*C\n",
+		reading.getPercentHumidity(), reading.getTemperatureCelsius(), reading.getTemperatureFahrenheit(),
+		reading.getHeatIndexCelsius(), reading.getHeatIndexFahrenheit(), reading.getDewPointCelsius());
+
+	// everything should match the separate calls, which won't read the
+	// sensor again this soon
+	matches = reading.isValid() &&
+		reading.getTemperatureCelsius() == dht.getTemperatureCelsius() &&
+		reading.getPercentHumidity() == dht.getPercentHumidity() &&
+		reading.getTemperatureFahrenheit() == dht.getTemperatureFahrenheit() &&
+		reading.getTemperatureTenthsC() == dht.getTemperatureTenthsC() &&
+		reading.getTemperatureTenthsF() == dht.getTemperatureTenthsF() &&
+		reading.getHumidityTenths() == dht.getHumidityTenths() &&
+		reading.getHeatIndexFahrenheit() == dht.readHeatIndexFahrenheit() &&
+		reading.getHeatIndexCelsius() == dht.readHeatIndexCelsius() &&
+		reading.getHeatIndexTenthsF() == dht.readHeatIndexTenthsF() &&
+		reading.getHeatIndexTenthsC() == dht.readHeatIndexTenthsC() &&
+		reading.getDewPointCelsius() == DHT_TempHumidUtils::computeDewPointCelsius(dht.getTemperatureCelsius(), dht.getPercentHumidity());
+	printf("Read all: %s the separate calls\n", check(matches) ? "matches" : "doesn't match");
+
+	// reading again right away reuses the same data; after the sample
+	// window, there's new data
+	dht.readAll(reading);
+	printf("Read all: generation %s when read again right away", check(reading.getGeneration() == generation) ? "unchanged" : "changed (oops!)");
+	setSensorValues(pin, celsius_ + 1.0, humidity_ + 1.0, 16);
+	delay(2000);
+	dht.readAll(reading);
+	printf(", %s after the sample window (temperature now %5.1f*C)\n",
+		check(reading.getGeneration() == (uint16_t)(generation + 1)) ? "advanced" : "didn't advance (oops!)", reading.getTemperatureCelsius());
+
+	// a failed read, with no fallback, leaves nothing valid
+	setSensorFault(pin, MOCK_FAULT_NO_RESPONSE);
+	delay(2000);
+	dht.readAll(reading);
+	setSensorFault(pin, MOCK_FAULT_NONE);
+	check(!reading.isValid() && isnan(reading.getTemperatureCelsius()) && isnan(reading.getHeatIndexFahrenheit()));
+	printf("Read all: after a failed read, valid %d, temperature %5.1f*C, heat index %5.1f*F\n",
+		reading.isValid(), reading.getTemperatureCelsius(), reading.getHeatIndexFahrenheit());
+}
+
+// the handlers for testAsync(), which the mock runs as interrupts
+static DHTAsync *asyncSensor_;
+static void asyncEdgeHandler() {
+	asyncSensor_->handleEdge();
+}
+static void asyncTimerHandler() {
+	asyncSensor_->timerTick();
+}
+
+// run the main loop for a while, doing nothing but waiting, and report what
+// the handlers did in the background
+static void runAsync(DHTAsync &dht, const char *description, unsigned long millis_) {
+	uint8_t frames = dht.getFrameCount();
+	MockStats stats;
+
+	resetMockStats();
+	delay(millis_);
+	stats = getMockStats();
+	printf("Async, %s: status %d, %d new frames, humidity %4.1f%%, temperature %5.1f*C, longest handler %lluus\n",
+		description, dht.getStatus(), (uint8_t)(dht.getFrameCount() - frames), dht.getPercentHumidity(),
+		dht.getTemperatureCelsius(), (unsigned long long)stats.maxInterruptsOffMicros);
+}
+
+void testAsync(DHTAsync &dht, uint8_t pin) {
+	asyncSensor_ = &dht;
+	setSensorValues(pin, 21.7, 48.3, 16);
+	dht.begin(asyncEdgeHandler);
+	setTimerInterrupt(asyncTimerHandler, 1000);
+
+	runAsync(dht, "after 5 seconds", 5000);
+	setSensorValues(pin, -3.4, 77.1, 16);
+	runAsync(dht, "new values", 2000);
+
+	// a failed read leaves the last good frame in place
+	setSensorFault(pin, MOCK_FAULT_CORRUPT_BIT, 13, 0, 1);
+	setSensorValues(pin, 8.8, 33.3, 16);
+	runAsync(dht, "a corrupted bit", 2000);
+	runAsync(dht, "and then a good read", 2000);
+
+	// the threshold follows the sensor's timing
+	setSensorTimeScale(pin, 65);
+	setSensorValues(pin, 30.1, 41.2, 16);
+	runAsync(dht, "a fast sensor", 2000);
+	setSensorTimeScale(pin, 160);
+	setSensorValues(pin, 12.5, 58.6, 16);
+	runAsync(dht, "a slow sensor", 2000);
+	setSensorTimeScale(pin, 100);
+
+	setTimerInterrupt(NULL, 0);
+	detachInterrupt(digitalPinToInterrupt(pin));
+}
+
+#if DHT_ENABLE_SNAPSHOT
+// the handler for testSnapshot(), which the mock runs as a timer interrupt
+// in the middle of reads; every snapshot it sees should be a whole one
+static DHT *snapshotSensor_;
+static unsigned long snapshotReads_, snapshotTorn_;
+static uint16_t snapshotGenerations_[2];
+static void snapshotTimerHandler() {
+	DHTSnapshot snapshot;
+
+	snapshotSensor_->getSnapshot(snapshot);
+	snapshotReads_++;
+	if (snapshot.valid && !snapshot.frame.isChecksumValid()) {
+		snapshotTorn_++;
+	}
+	if (snapshot.generation < snapshotGenerations_[0]) {
+		snapshotGenerations_[0] = snapshot.generation;
+	}
+	if (snapshot.generation > snapshotGenerations_[1]) {
+		snapshotGenerations_[1] = snapshot.generation;
+	}
+}
+#endif
+
+// a writer thread publishing as fast as it can, and reader threads checking
+// that every snapshot they get is a whole one; each field of a snapshot is
+// derived from the same counter
+static DHTSnapshotSlot threadSlot_;
+static volatile boolean threadsDone_;
+
+static void publishThreadSnapshot(unsigned long i) {
+	DHTSnapshot snapshot;
+
+	for (uint8_t j = 0; j < DHT_NUM_BYTES; j++) {
+		snapshot.frame.data[j] = i + j;
+	}
+	snapshot.frame.type = i;
+	snapshot.valid = i & 1;
+	snapshot.status = i & 7;
+	snapshot.generation = i;
+	snapshot.timestamp = i;
+	threadSlot_.publish(snapshot);
+}
+
+static void* snapshotWriter(void *arg) {
+	for (unsigned long i = 1; i <= *(unsigned long*)arg; i++) {
+		publishThreadSnapshot(i);
+	}
+	threadsDone_ = true;
+	return NULL;
+}
+
+static void* snapshotReader(void *arg) {
+	unsigned long *counts = (unsigned long*)arg;
+	DHTSnapshot snapshot;
+	unsigned long i;
+	boolean whole;
+
+	while (!threadsDone_) {
+		threadSlot_.read(snapshot);
+		i = snapshot.timestamp;
+		whole = snapshot.frame.type == (uint8_t)i && snapshot.valid == (boolean)(i & 1) && snapshot.status == (i & 7) &&
+			snapshot.generation == (uint16_t)i;
+		for (uint8_t j = 0; j < DHT_NUM_BYTES; j++) {
+			whole = whole && snapshot.frame.data[j] == (uint8_t)(i + j);
+		}
+		counts[0]++;
+		counts[1] += !whole;
+	}
+	return NULL;
+}
+
+void testSnapshot(DHT &dht, uint8_t pin, unsigned int numReads) {
+	pthread_t writer, readers[2];
+	unsigned long numPublishes = 2000000, counts[2][2] = {{0, 0}, {0, 0}};
+
+#if DHT_ENABLE_SNAPSHOT
+	DHTSnapshot snapshot;
+	unsigned int i, matches = 0;
+
+	snapshotSensor_ = &dht;
+	snapshotReads_ = snapshotTorn_ = 0;
+	snapshotGenerations_[0] = 0xFFFF;
+	snapshotGenerations_[1] = 0;
+	setTimerInterrupt(snapshotTimerHandler, 250);
+	for (i = 0; i < numReads; i++) {
+		setSensorValues(pin, 10.0 + i, 40.0 + i, 16);
+		setSensorFault(pin, (i % 3 == 2) ? MOCK_FAULT_CORRUPT_BIT : MOCK_FAULT_NONE, 7, 0, 1);
+		delay(2000);
+		dht.readSensorData();
+		dht.getSnapshot(snapshot);
+		if (snapshot.valid == (dht.getTemperatureTenthsC() != DHT_INVALID_TENTHS) && snapshot.generation == dht.getGeneration() &&
+				(!snapshot.valid || (snapshot.frame.getTemperatureTenthsC() == dht.getTemperatureTenthsC() &&
+				snapshot.frame.getHumidityTenths() == dht.getHumidityTenths() && snapshot.timestamp == dht.getValueTimestamp()))) {
+			matches++;
+		}
+	}
+	setTimerInterrupt(NULL, 0);
+	setSensorFault(pin, MOCK_FAULT_NONE);
+	check(matches == numReads && snapshotTorn_ == 0);
+	printf("Snapshot: %u of %u reads match the get*() functions; the timer interrupt took %lu snapshots, %lu torn, generations %u-%u\n",
+		matches, numReads, snapshotReads_, snapshotTorn_, snapshotGenerations_[0], snapshotGenerations_[1]);
+#endif
+
+	threadsDone_ = false;
+	publishThreadSnapshot(0);
+	pthread_create(&readers[0], NULL, snapshotReader, counts[0]);
+	pthread_create(&readers[1], NULL, snapshotReader, counts[1]);
+	pthread_create(&writer, NULL, snapshotWriter, &numPublishes);
+	pthread_join(writer, NULL);
+	pthread_join(readers[0], NULL);
+	pthread_join(readers[1], NULL);
+	check(counts[0][1] + counts[1][1] == 0);
+	printf("Snapshot: %lu publishes from one thread, %lu reads from two others, %lu torn\n",
+		numPublishes, counts[0][0] + counts[1][0], counts[0][1] + counts[1][1]);
+}
+
+// one sensor in each of several mock environments, on the same pin; each
+// read should see only its own environment's sensor values and clock
+static unsigned int readInEnvironment(DHT &dht, float celsius_, float humidity_) {
+	delay(2000);
+	setSensorValues(2, celsius_, humidity_, 16);
+	return dht.readSensorData() && dht.getTemperatureTenthsC() == (int16_t)round(celsius_ * 10.0) &&
+		dht.getHumidityTenths() == (int16_t)round(humidity_ * 10.0);
+}
+
+// a thread reading a sensor in its own thread's environment, without ever
+// setting one up
+static void* environmentThread(void *arg) {
+	unsigned int *result = (unsigned int*)arg;
+	DHT dht(2, DHT_SENSOR_TYPE_DHT22);
+	unsigned int i;
+
+	dht.begin();
+	for (i = 0; i < 5; i++) {
+		result[1] += readInEnvironment(dht, result[0] + i, 30.0 + result[0]);
+	}
+	return NULL;
+}
+
+void testEnvironments() {
+	MockEnvironment *environments[2];
+	DHT *sensors[2];
+	unsigned long mainStart = millis(), starts[2];
+	unsigned int i, j, matches = 0, clocks = 0, threadMatches = 0, threadResults[4][2];
+	pthread_t threads[4];
+
+	for (j = 0; j < 2; j++) {
+		environments[j] = createMockEnvironment();
+		setMockEnvironment(environments[j]);
+		sensors[j] = new DHT(2, DHT_SENSOR_TYPE_DHT22);
+		sensors[j]->begin();
+		starts[j] = millis();
+	}
+	for (i = 0; i < 5; i++) {
+		for (j = 0; j < 2; j++) {
+			setMockEnvironment(environments[j]);
+			matches += readInEnvironment(*sensors[j], 10.0*j + i, 50.0 - 10.0*j);
+		}
+	}
+	for (j = 0; j < 2; j++) {
+		setMockEnvironment(environments[j]);
+		// 5 reads, 2 seconds apart, plus the time they took; a shared
+		// clock would have seen all 10
+		clocks += millis() - starts[j] >= 10000 && millis() - starts[j] < 11000;
+		delete sensors[j];
+		destroyMockEnvironment(environments[j]);
+	}
+	setMockEnvironment(NULL);
+	check(matches == 10 && clocks == 2 && millis() == mainStart);
+	printf("Environments: %u of 10 interleaved reads match their own environment's values; %u of 2 clocks ran on their own, main clock %s\n",
+		matches, clocks, (millis() == mainStart) ? "untouched" : "moved");
+
+	for (j = 0; j < 4; j++) {
+		threadResults[j][0] = 10*j;
+		threadResults[j][1] = 0;
+		pthread_create(&threads[j], NULL, environmentThread, threadResults[j]);
+	}
+	for (j = 0; j < 4; j++) {
+		pthread_join(threads[j], NULL);
+		threadMatches += threadResults[j][1];
+	}
+	check(threadMatches == 20);
+	printf("Environments: %u of 20 reads on four threads match their own thread's values\n", threadMatches);
+}
+
+// the edges of a read of the given bytes (in the order they're sent), in
+// ticks of 1/16 microsecond: each signal is off by up to jitterMicros either
+// way, and each HIGH is stretched by slowMicros, like a sensor whose line
+// rises slowly
+#define TRACE_TICKS_PER_MICRO 16
+static unsigned int traceRead(uint32_t *ticks, const uint8_t *bytes, int jitterMicros, int slowMicros) {
+	unsigned int numEdges = 0;
+	int length, bit;
+
+	ticks[numEdges++] = 30 * TRACE_TICKS_PER_MICRO;
+	for (int pulse = 0; pulse < MOCK_TRACE_EDGES_PER_READ-1; pulse++) {
+		if (pulse < 2) {
+			length = 80;
+		} else if (pulse % 2 == 0) {
+			length = 50;
+		} else {
+			bit = (pulse-3) / 2;
+			length = (bytes[bit/8] & (0x80 >> (bit%8))) ? 70 : 26;
+		}
+		if (pulse % 2 == 1) {
+			length += slowMicros;
+		}
+		ticks[numEdges++] = length * TRACE_TICKS_PER_MICRO + rand() % (2*jitterMicros*TRACE_TICKS_PER_MICRO + 1) - jitterMicros*TRACE_TICKS_PER_MICRO;
+	}
+	return numEdges;
+}
+
+// starts a read, and waits for it to finish
+static uint8_t readStatus(DHT &dht) {
+	uint8_t status;
+
+	delay(2000);
+	if (!dht.startRead()) {
+		return DHT_READ_NOT_STARTED;
+	}
+	while ((status = dht.poll()) == DHT_READ_IN_PROGRESS) {
+		delayMicroseconds(100);
+	}
+	return status;
+}
+
+void testTrace(DHT &dht, uint8_t pin) {
+	static uint8_t trace[16384];
+	uint32_t ticks[MOCK_TRACE_MAX_EDGES];
+	uint8_t bytes[DHT_NUM_BYTES];
+	unsigned int length, numEdges, i, matches = 0;
+	uint8_t statuses[4];
+	FILE *file;
+
+	// jittery reads of 20.0-25.0*C and 40.0-45.0%, each sped up or slowed
+	// down a little more than the last
+	srand(2468);
+	length = writeTraceHeader(trace, DHT_SENSOR_TYPE_DHT22, TRACE_TICKS_PER_MICRO);
+	for (i = 0; i < 6; i++) {
+		bytes[0] = (400 + 10*i) >> 8;
+		bytes[1] = (400 + 10*i) & 0xFF;
+		bytes[2] = (200 + 10*i) >> 8;
+		bytes[3] = (200 + 10*i) & 0xFF;
+		bytes[4] = bytes[0] + bytes[1] + bytes[2] + bytes[3];
+		numEdges = traceRead(ticks, bytes, 1 + i, 2*i);
+		length += writeTraceRecord(trace + length, ticks, numEdges);
+	}
+	// the last of those again, with an 8 microsecond glitch LOW halfway
+	// through the HIGH of its first "1" bit (bit 7, pulse 17, whose length
+	// is edge 18's)
+	memmove(ticks + 20, ticks + 18, (numEdges - 18) * sizeof(uint32_t));
+	ticks[18] = ticks[20] / 2;
+	ticks[19] = 8 * TRACE_TICKS_PER_MICRO;
+	ticks[20] -= ticks[18] + ticks[19];
+	numEdges += 2;
+	length += writeTraceRecord(trace + length, ticks, numEdges);
+	// a read the sensor never answered, and one it gave up on halfway
+	// through a bit's LOW, leaving the line stuck LOW
+	length += writeTraceRecord(trace + length, ticks, 0);
+	length += writeTraceRecord(trace + length, ticks, 41);
+
+	if (!check(setSensorTrace(pin, trace, length))) {
+		printf("Trace: rejected!\n");
+		return;
+	}
+	for (i = 0; i < 6; i++) {
+		if (readStatus(dht) == DHT_READ_OK && dht.getTemperatureTenthsC() == (int16_t)(200 + 10*i) &&
+				dht.getHumidityTenths() == (int16_t)(400 + 10*i)) {
+			matches++;
+		}
+	}
+	for (i = 0; i < 4; i++) {
+		statuses[i] = readStatus(dht);
+	}
+	check(matches == 6 && statuses[0] == DHT_READ_CHECKSUM_ERROR && statuses[1] == DHT_READ_TIMEOUT &&
+		statuses[2] == DHT_READ_TIMEOUT && statuses[3] == DHT_READ_OK);
+	printf("Trace: %u of 6 jittery reads match; a glitch gives status %d, then status %d without a response, %d stuck LOW, %d looped back\n",
+		matches, statuses[0], statuses[1], statuses[2], statuses[3]);
+
+	// the same trace from a file, at 150% of its speed, without looping
+	file = fopen("trace_test.bin", "wb");
+	fwrite(trace, 1, length, file);
+	fclose(file);
+	setSensorTimeScale(pin, 150);
+	if (!check(loadSensorTrace(pin, "trace_test.bin", false))) {
+		printf("Trace: file rejected!\n");
+	}
+	remove("trace_test.bin");
+	for (i = 0, matches = 0; i < 6; i++) {
+		if (readStatus(dht) == DHT_READ_OK && dht.getTemperatureTenthsC() == (int16_t)(200 + 10*i)) {
+			matches++;
+		}
+	}
+	for (i = 0; i < 3; i++) {
+		readStatus(dht);
+	}
+	statuses[0] = readStatus(dht);
+	check(matches == 6 && statuses[0] == DHT_READ_TIMEOUT);
+	printf("Trace: %u of 6 reads from a file at 150%% match; after the end, status %d\n", matches, statuses[0]);
+
+	trace[0] = 'X';
+	printf("Trace: a damaged trace is %s\n", check(!setSensorTrace(pin, trace, length)) ? "rejected" : "accepted!");
+	setSensorTrace(pin, NULL, 0);
+	setSensorTimeScale(pin, 100);
+}
+
+void testFrameBatch(uint32_t count) {
+	DHTFrame *frames = new DHTFrame[count];
+	int16_t *temperatures = new int16_t[count], *humidities = new int16_t[count];
+	uint32_t numValid, expectedValid = 0, mismatches = 0;
+	static const uint8_t types[] = {DHT_SENSOR_TYPE_DHT11, DHT_SENSOR_TYPE_DHT21, DHT_SENSOR_TYPE_DHT22};
+
+	// arbitrary bytes, with a correct checksum on most of them
+	srand(1234);
+	for (uint32_t i = 0; i < count; i++) {
+		frames[i].type = types[i % 3];
+		for (uint8_t j = 1; j < DHT_NUM_BYTES; j++) {
+			frames[i].data[j] = rand();
+		}
+		frames[i].data[0] = frames[i].data[1] + frames[i].data[2] + frames[i].data[3] + frames[i].data[4] + (i % 5 == 0);
+	}
+
+	// the batch should agree with decoding the frames one at a time, and
+	// with the sensor traits
+	numValid = DHTFrame::decodeBatch(frames, count, temperatures, humidities);
+	for (uint32_t i = 0; i < count; i++) {
+		int16_t temperature = DHT_INVALID_TENTHS, humidity = DHT_INVALID_TENTHS;
+		if (frames[i].isChecksumValid()) {
+			expectedValid++;
+			if (frames[i].type == DHT_SENSOR_TYPE_DHT11) {
+				temperature = DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::decodeTemperatureTenths(frames[i].data);
+				humidity = DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::decodeHumidityTenths(frames[i].data);
+			} else {
+				temperature = DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::decodeTemperatureTenths(frames[i].data);
+				humidity = DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::decodeHumidityTenths(frames[i].data);
+			}
+		}
+		if (temperatures[i] != frames[i].getTemperatureTenthsC() || humidities[i] != frames[i].getHumidityTenths() ||
+				temperatures[i] != temperature || humidities[i] != humidity) {
+			mismatches++;
+		}
+	}
+	check(numValid == expectedValid && mismatches == 0);
+	printf("Frame batch: %lu of %lu valid (expected %lu), %lu mismatches\n", (unsigned long)numValid, (unsigned long)count,
+		(unsigned long)expectedValid, (unsigned long)mismatches);
+
+	delete[] frames;
+	delete[] temperatures;
+	delete[] humidities;
+}
+
+void testDerivedMetrics() {
+	double temperature, humidity, gamma, dewPoint, absoluteHumidity;
+	double dewPointError = 0, absoluteHumidityError = 0, error;
+
+	// check the dew point and absolute humidity against the exact formulas,
+	// at every temperature and humidity a DHT22 can report
+	for (int16_t t = -400; t <= 800; t++) {
+		for (int16_t rh = 1; rh <= 1000; rh++) {
+			temperature = t / 10.0;
+			humidity = rh / 10.0;
+			gamma = log(humidity/100) + 17.62*temperature/(243.12+temperature);
+			dewPoint = 243.12*gamma/(17.62-gamma);
+			absoluteHumidity = 216.74 * humidity/100 * 6.112*exp(17.62*temperature/(243.12+temperature)) / (273.15+temperature);
+
+			error = fabs(DHT_TempHumidUtils::computeDewPointTenthsCelsius(t, rh)/10.0 - dewPoint);
+			dewPointError = (error > dewPointError) ? error : dewPointError;
+			error = fabs(DHT_TempHumidUtils::computeAbsoluteHumidityTenths(t, rh)/10.0 - absoluteHumidity);
+			absoluteHumidityError = (error > absoluteHumidityError) ? error : absoluteHumidityError;
+		}
+	}
+	printf("Dew point at 25.0*C and 60.0%%: %4.1f*C / %4.1f*F, absolute humidity %4.1fg/m^3\n",
+		DHT_TempHumidUtils::computeDewPointCelsius(25.0, 60.0), DHT_TempHumidUtils::computeDewPointFahrenheit(77.0, 60.0),
+		DHT_TempHumidUtils::computeAbsoluteHumidity(25.0, 60.0));
+	printf("Dew point within %.3f*C, absolute humidity within %.3fg/m^3%s\n", dewPointError, absoluteHumidityError,
+		check(dewPointError <= 0.06 && absoluteHumidityError <= 0.07) ? "" : " (worse than documented!)");
+}
+
+#if DHT_ENABLE_STATS
+void printStats(DHT &dht) {
+	const DHTStats &stats = dht.getStats();
+
+	printf("Stats: %u attempts, %u cache hits, %u backoff skips, %u good (%u corrected), %u fallbacks, %u checksum errors, timeouts %u/%u/%u/%u, worst margin %uus\n",
+		stats.attempts, stats.cacheHits, stats.backoffSkips, stats.goodReads, stats.correctedReads, stats.fallbacks, stats.checksumErrors,
+		stats.timeouts[DHT_STATS_TIMEOUT_NO_RESPONSE], stats.timeouts[DHT_STATS_TIMEOUT_RESPONSE_LOW],
+		stats.timeouts[DHT_STATS_TIMEOUT_RESPONSE_HIGH], stats.timeouts[DHT_STATS_TIMEOUT_DATA],
+		stats.worstMarginMicros);
+	printf("Stats: 0 bits");
+	for (uint8_t i = 0; i < DHT_STATS_HISTOGRAM_BINS; i++) {
+		printf(" %u", stats.zeroBitHistogram[i]);
+	}
+	printf(", 1 bits");
+	for (uint8_t i = 0; i < DHT_STATS_HISTOGRAM_BINS; i++) {
+		printf(" %u", stats.oneBitHistogram[i]);
+	}
+	printf("\n");
+}
+#endif
+
 int main(int argc, char** argv) {
 
 	DHT dht16(2, DHT_SENSOR_TYPE_DHT22);
@@ -43,6 +874,248 @@ int main(int argc, char** argv) {
 	testCode(-38.7, 9.2, dht16, 16);
 	delay(2000);
 	testCode(30.2, 75.3, dht16, 16);
+	delay(2000);
+	testNonBlocking(21.6, 48.5, dht16, 16);
+	delay(2000);
+	printf("\n");
+
+	// the compile-time pin variants read the mock port registers
+	DHTFast<DHTPortPin<2> > dhtPort(DHT_SENSOR_TYPE_DHT22);
+	dhtPort.begin();
+	testCode(37.1, 30.4, dhtPort, 16);
+	delay(2000);
+	testCode(-38.7, 9.2, dhtPort, 16);
+	delay(2000);
+	resetMockStats();
+	dhtPort.readSensorData();
+	printf("DHTFast<DHTPortPin> read with %lu digitalRead() calls\n", getMockStats().digitalReads);
+	check(getMockStats().digitalReads == 0);
+	delay(2000);
+	DHTFast<DHTDigitalPin<2> > dhtDigital(DHT_SENSOR_TYPE_DHT22);
+	dhtDigital.begin();
+	testCode(30.2, 75.3, dhtDigital, 16);
+	delay(2000);
+	printf("\n");
+
+	// the compile-time sensor types should decode just the same
+	DHTSensor<DHT_SENSOR_TYPE_DHT22> dhtTyped16(2);
+	dhtTyped16.begin();
+	testCode(-38.7, 9.2, dhtTyped16, DHTSensor<DHT_SENSOR_TYPE_DHT22>::Traits::VALUE_BITS);
+	delay(2000);
+	DHTSensor<DHT_SENSOR_TYPE_DHT11> dhtTyped8(2);
+	dhtTyped8.begin();
+	testCode(30.2, 75.3, dhtTyped8, DHTSensor<DHT_SENSOR_TYPE_DHT11>::Traits::VALUE_BITS);
+	// ... in readAll() too, without storing the type
+	DHTReading typedReading;
+	dhtTyped8.readAll(typedReading);
+	printf("DHTSensor<DHT11>: readAll() %s the get*() functions, %s than a DHT\n",
+		check(typedReading.isValid() && typedReading.getTemperatureTenthsC() == dhtTyped8.getTemperatureTenthsC() &&
+			typedReading.getHumidityTenths() == dhtTyped8.getHumidityTenths()) ? "matches" : "doesn't match",
+		check(sizeof(dhtTyped8) < sizeof(DHT)) ? "smaller" : "no smaller");
+	delay(2000);
+	printf("\n");
+
+	// several sensors read in a single timing loop
+	DHT dhtA(3, DHT_SENSOR_TYPE_DHT22);
+	DHT dhtB(4, DHT_SENSOR_TYPE_DHT22);
+	DHT dhtC(5, DHT_SENSOR_TYPE_DHT22);
+	DHT *arraySensors[] = { &dhtA, &dhtB, &dhtC };
+	const uint8_t arrayPins[] = { 3, 4, 5 };
+	DHTArray array;
+	array.add(dhtA);
+	array.add(dhtB);
+	array.add(dhtC);
+	array.begin();
+	testArray(24.3, 55.1, array, arraySensors, arrayPins, 3, 16);
+	delay(2000);
+	testArray(-12.8, 87.6, array, arraySensors, arrayPins, 3, 16);
+	delay(2000);
+	printf("\n");
+
+	// a misbehaving sensor on a pin of its own; expect timeouts (3) and
+	// checksum errors (4), except where a bit that was nearly read correctly
+	// can be corrected, then a good read (1) once the faults are gone
+	DHT dhtFaulty(6, DHT_SENSOR_TYPE_DHT22);
+	dhtFaulty.begin();
+	setSensorValues(6, 21.6, 48.5, 16);
+	testFault(dhtFaulty, 6, "no response", MOCK_FAULT_NO_RESPONSE, 0, 0);
+	delay(2000);
+	testFault(dhtFaulty, 6, "a stalled response LOW", MOCK_FAULT_STRETCHED_PULSE, 0, 300);
+	delay(2000);
+	testFault(dhtFaulty, 6, "a stalled response HIGH", MOCK_FAULT_STRETCHED_PULSE, 1, 300);
+	delay(2000);
+	testFault(dhtFaulty, 6, "a dropped bit", MOCK_FAULT_DROPPED_BIT, 17, 0);
+	delay(2000);
+	testFault(dhtFaulty, 6, "a 0 bit stretched into a 1", MOCK_FAULT_STRETCHED_PULSE, 5, 40);
+	printf("Humidity: %4.1f%%     Temperature: %5.1f*C\n", dhtFaulty.getPercentHumidity(), dhtFaulty.getTemperatureCelsius());
+	delay(2000);
+	testFault(dhtFaulty, 6, "a 0 bit stretched well into a 1", MOCK_FAULT_STRETCHED_PULSE, 5, 60);
+	delay(2000);
+	testFault(dhtFaulty, 6, "a stalled pulse", MOCK_FAULT_STRETCHED_PULSE, 5, 300);
+	delay(2000);
+	testFault(dhtFaulty, 6, "a corrupted bit", MOCK_FAULT_CORRUPT_BIT, 20, 0);
+	delay(2000);
+	testFault(dhtFaulty, 6, "no faults", MOCK_FAULT_NONE, 0, 0);
+#if DHT_ENABLE_STATS
+	// one more read right away comes from the cache
+	dhtFaulty.readSensorData();
+	printStats(dhtFaulty);
+#endif
+	delay(2000);
+	printf("\n");
+
+	// a sensor that goes missing for a while
+	DHT dhtMissing(8, DHT_SENSOR_TYPE_DHT22);
+	dhtMissing.begin();
+	setSensorValues(8, 19.4, 40.2, 16);
+	testDisconnect(dhtMissing, 8);
+#if DHT_ENABLE_STATS
+	printStats(dhtMissing);
+#endif
+	printf("\n");
+
+	// a sensor that fails now and then, read with retries and a fallback to
+	// values up to 10 seconds old
+	DHT dhtRetried(9, DHT_SENSOR_TYPE_DHT22);
+	dhtRetried.begin();
+	dhtRetried.setRetryPolicy(2, 2500, 10000);
+	setSensorValues(9, 25.5, 33.3, 16);
+	testRetries(dhtRetried, 9, "No faults", MOCK_FAULT_NONE, 0);
+	delay(2000);
+	setSensorValues(9, 26.0, 34.0, 16);
+	testRetries(dhtRetried, 9, "One bad read", MOCK_FAULT_CORRUPT_BIT, 1);
+	delay(2000);
+	setSensorValues(9, 26.5, 35.0, 16);
+	testRetries(dhtRetried, 9, "Three bad reads", MOCK_FAULT_CORRUPT_BIT, 3);
+	delay(2000);
+	testRetries(dhtRetried, 9, "Three more bad reads", MOCK_FAULT_CORRUPT_BIT, 3);
+	delay(2000);
+#if DHT_ENABLE_STATS
+	printStats(dhtRetried);
+#endif
+	printf("\n");
+
+	// a history of readings, which should keep its statistics up to date
+	DHT dhtLogged(10, DHT_SENSOR_TYPE_DHT22);
+	dhtLogged.begin();
+	testHistory(dhtLogged, 10);
+	printf("\n");
+
+	// several sensors shared by a scheduler, with a main loop that can only
+	// rarely spare the time for a burst, then one that can only once (so the
+	// read it starts gets cancelled), and then one that never can
+	DHT dhtScheduled1(11, DHT_SENSOR_TYPE_DHT22), dhtScheduled2(12, DHT_SENSOR_TYPE_DHT22), dhtScheduled3(13, DHT_SENSOR_TYPE_DHT11);
+	DHT *scheduled[] = {&dhtScheduled1, &dhtScheduled2, &dhtScheduled3};
+	DHTScheduler scheduler;
+	for (uint8_t i = 0; i < 3; i++) {
+		scheduler.add(*scheduled[i]);
+	}
+	scheduler.begin();
+	setSensorValues(11, 20.5, 45.5, 16);
+	setSensorValues(12, 21.5, 46.5, 16);
+	setSensorValues(13, 22.0, 47.0, 8);
+	testScheduler(scheduler, scheduled, 3, 8000, 0, 10);
+	testScheduler(scheduler, scheduled, 3, 1000, 10, 10);
+	delay(2000);
+	testScheduler(scheduler, scheduled, 3, 1000, 1000000, 4);
+	testScheduler(scheduler, scheduled, 3, 1000, 0, 4);
+	printf("\n");
+
+	// sensors of the same type all come due at once, but their reads should
+	// get staggered rather than crowding each other out; each DHT22 should
+	// get a read about every 2 seconds
+	DHT *crowded[6];
+	DHTScheduler crowdedScheduler;
+	for (uint8_t i = 0; i < 6; i++) {
+		crowded[i] = new DHT(40 + i, DHT_SENSOR_TYPE_DHT22);
+		crowdedScheduler.add(*crowded[i]);
+		setSensorValues(40 + i, 20.0 + i, 40.0 + i, 16);
+	}
+	crowdedScheduler.begin();
+	testScheduler(crowdedScheduler, crowded, 6, 20000, 0, 30, 14);
+	for (uint8_t i = 0; i < 6; i++) {
+		delete crowded[i];
+	}
+
+	// a scheduler of DHTFast sensors should read them through their pin
+	// policy, not digitalRead()
+	DHTFast<DHTPortPin<46> > dhtFastScheduled(DHT_SENSOR_TYPE_DHT22);
+	DHTBasicScheduler<DHTFast<DHTPortPin<46> > > fastScheduler;
+	fastScheduler.add(dhtFastScheduled);
+	fastScheduler.begin();
+	setSensorValues(46, 23.4, 43.2, 16);
+	resetMockStats();
+	while (!fastScheduler.tick(20000)) {
+		delayMicroseconds(500);
+	}
+	printf("Scheduled DHTFast<DHTPortPin>: status %d, humidity %4.1f%%, temperature %5.1f*C, %lu digitalRead() calls\n",
+		dhtFastScheduled.poll(), dhtFastScheduled.getPercentHumidity(), dhtFastScheduled.getTemperatureCelsius(), getMockStats().digitalReads);
+	check(dhtFastScheduled.poll() == DHT_READ_OK && getMockStats().digitalReads == 0);
+	printf("\n");
+
+	// a binary log of readings, which should decode back to the same values
+	DHT dhtLogged2(14, DHT_SENSOR_TYPE_DHT22);
+	dhtLogged2.begin();
+	testLog(dhtLogged2, 14, 100);
+	printf("\n");
+
+	// raw frames, read from sensors and decoded on their own
+	DHT dhtFramed22(15, DHT_SENSOR_TYPE_DHT22), dhtFramed11(16, DHT_SENSOR_TYPE_DHT11);
+	dhtFramed22.begin();
+	dhtFramed11.begin();
+	testFrame(dhtFramed22, 15, -12.3, 67.8, 16);
+	testFrame(dhtFramed22, 15, 31.4, 15.9, 16);
+	testFrame(dhtFramed11, 16, 24.0, 51.0, 8);
+	testFrameBatch(10000);
+	printf("\n");
+
+	// reads done entirely by interrupt handlers, in the background
+	DHTAsync dhtAsync(18, DHT_SENSOR_TYPE_DHT22);
+	testAsync(dhtAsync, 18);
+	printf("\n");
+
+	// snapshots, read from an interrupt handler and other threads
+	DHT dhtSnapshot(19, DHT_SENSOR_TYPE_DHT22);
+	dhtSnapshot.begin();
+	testSnapshot(dhtSnapshot, 19, 12);
+	printf("\n");
+
+	// sensors in mock environments of their own, and on other threads
+	testEnvironments();
+	printf("\n");
+
+	// reads replayed from a recorded trace, with all its flaws
+	DHT dhtTraced(20, DHT_SENSOR_TYPE_DHT22);
+	dhtTraced.begin();
+	testTrace(dhtTraced, 20);
+	printf("\n");
+
+	// everything from one read, computed only as needed
+	DHT dhtReadAll(17, DHT_SENSOR_TYPE_DHT22);
+	dhtReadAll.begin();
+	testReadAll(dhtReadAll, 17, 31.2, 64.5);
+	printf("\n");
+
+	// derived metrics computed without the floating point libraries
+	testDerivedMetrics();
+	printf("\n");
+
+	// sensors whose timing is off; the bit threshold should follow along
+	DHT dhtSkewed(7, DHT_SENSOR_TYPE_DHT22);
+	dhtSkewed.begin();
+	setSensorValues(7, 27.3, 61.9, 16);
+	setSensorTimeScale(7, 60);
+	testFault(dhtSkewed, 7, "a fast sensor", MOCK_FAULT_NONE, 0, 0);
+	printf("Humidity: %4.1f%%     Temperature: %5.1f*C     (bit threshold %uus)\n", dhtSkewed.getPercentHumidity(), dhtSkewed.getTemperatureCelsius(), DHT::computeBitThreshold(dhtSkewed.getPulseWidths()));
+	delay(2000);
+	setSensorTimeScale(7, 190);
+	testFault(dhtSkewed, 7, "a slow sensor", MOCK_FAULT_NONE, 0, 0);
+	printf("Humidity: %4.1f%%     Temperature: %5.1f*C     (bit threshold %uus)\n", dhtSkewed.getPercentHumidity(), dhtSkewed.getTemperatureCelsius(), DHT::computeBitThreshold(dhtSkewed.getPulseWidths()));
+#if DHT_ENABLE_STATS
+	// the "1" bit bins start at each read's own threshold, so neither read's
+	// "1" bits should pile up in the first or last bin
+	printStats(dhtSkewed);
+#endif
 	delay(2000);
 	printf("\n");
 
@@ -56,4 +1129,9 @@ int main(int argc, char** argv) {
 	testCode(-38.7, 9.2, dht8, 8);
 	delay(2000);
 	testCode(30.2, 75.3, dht8, 8);
+
+	if (failures_) {
+		printf("\n%u checks failed!\n", failures_);
+	}
+	return failures_ ? 1 : 0;
 }
@@ -0,0 +1,397 @@
+// Benchmark of the sensor read paths, using the mock's virtual clock to see
+// how long each read blocks, how long it keeps interrupts off, and how many
+// pin reads it makes per signal edge; the host time spent decoding is
+// measured with a real clock.
+//
+// Each result is printed as one JSON object per line, so the output of two
+// library versions can be compared by a script.
+//
+// Written by Joe Ibershoff, released under MIT license
+
+#include "WProgram.h"
+#include "DHT.h"
+#include "DHTAsync.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+
+#define NUM_READS 200
+#define NUM_DECODES 1000000
+#define NUM_BATCH_FRAMES 1000
+#define NUM_TRACE_RECORDS 1000
+#define NUM_TRACE_READS 20000
+#define TRACE_TICKS_PER_MICRO 16
+#define SENSOR_PIN 2
+
+// a full read is the response LOW and HIGH plus a LOW and HIGH per bit, and
+// the edge that ends the last one
+#define EDGES_PER_READ (DHT_NUM_PULSES + 1)
+
+
+struct PathResult {
+	unsigned int reads;
+	unsigned int ok;
+	uint64_t totalMicros;
+	uint64_t maxMicros;
+	uint64_t maxInterruptsOffMicros;
+	unsigned long digitalReads;
+	double hostSeconds;
+};
+
+static double nowSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void report(const char *type, const char *path, const PathResult &result) {
+	printf("{\"type\":\"%s\",\"path\":\"%s\",\"reads\":%u,\"ok\":%u,\"blocking_us\":%.1f,\"max_blocking_us\":%llu,"
+		"\"max_interrupts_off_us\":%llu,\"digital_reads\":%.1f,\"digital_reads_per_edge\":%.2f,\"host_ns\":%.0f}\n",
+		type, path, result.reads, result.ok,
+		(double)result.totalMicros / result.reads, (unsigned long long)result.maxMicros,
+		(unsigned long long)result.maxInterruptsOffMicros,
+		(double)result.digitalReads / result.reads, (double)result.digitalReads / result.reads / EDGES_PER_READ,
+		result.hostSeconds / result.reads * 1e9);
+}
+
+// time one call to readSensorData(), adding it to the result
+static void timeRead(DHT &dht, PathResult &result) {
+	uint64_t start, elapsed;
+	double hostStart;
+	MockStats stats;
+
+	resetMockStats();
+	start = getMockTimeMicros();
+	hostStart = nowSeconds();
+	if (dht.readSensorData()) {
+		result.ok++;
+	}
+	result.hostSeconds += nowSeconds() - hostStart;
+	elapsed = getMockTimeMicros() - start;
+	stats = getMockStats();
+
+	result.reads++;
+	result.totalMicros += elapsed;
+	if (elapsed > result.maxMicros) {
+		result.maxMicros = elapsed;
+	}
+	if (stats.maxInterruptsOffMicros > result.maxInterruptsOffMicros) {
+		result.maxInterruptsOffMicros = stats.maxInterruptsOffMicros;
+	}
+	result.digitalReads += stats.digitalReads;
+}
+
+// full reads, each one far enough after the last that it reaches the sensor;
+// the fault (if any) applies to every one of them
+static void benchmarkReads(const char *type, const char *path, DHT &dht, int fault, int position, long extraMicros) {
+	PathResult result = PathResult();
+
+	for (int i = 0; i < NUM_READS; i++) {
+		delay(dht.getMinSampleDelayMillis());
+		setSensorFault(SENSOR_PIN, fault, position, extraMicros, 1);
+		timeRead(dht, result);
+	}
+	setSensorFault(SENSOR_PIN, MOCK_FAULT_NONE);
+	report(type, path, result);
+}
+
+// reads of a sensor that doesn't answer.  Left alone, the library would
+// soon call it disconnected and skip most reads, so the two cases are timed
+// separately: each "no_response" read follows a good one, so it's a full
+// read that times out, and each "probe" is the first read allowed once the
+// backoff window (see DHT::isDisconnected()) of a disconnected sensor is up
+static void benchmarkNoResponse(const char *type, DHT &dht) {
+	PathResult timeouts = PathResult(), probes = PathResult();
+
+	for (int i = 0; i < NUM_READS; i++) {
+		delay(dht.getMinSampleDelayMillis());
+		dht.readSensorData();
+		delay(dht.getMinSampleDelayMillis());
+		setSensorFault(SENSOR_PIN, MOCK_FAULT_NO_RESPONSE, 0, 0, 1);
+		timeRead(dht, timeouts);
+	}
+	report(type, "no_response", timeouts);
+
+	setSensorFault(SENSOR_PIN, MOCK_FAULT_NO_RESPONSE);
+	while (!dht.isDisconnected()) {
+		delay(dht.getMinSampleDelayMillis());
+		dht.readSensorData();
+	}
+	for (int i = 0; i < NUM_READS; i++) {
+		while (!dht.isReadDue()) {
+			delay(dht.getMinSampleDelayMillis());
+		}
+		timeRead(dht, probes);
+	}
+	report(type, "probe", probes);
+
+	// plug it back in, so the paths after this one start out connected
+	setSensorFault(SENSOR_PIN, MOCK_FAULT_NONE);
+	while (!dht.isReadDue()) {
+		delay(dht.getMinSampleDelayMillis());
+	}
+	dht.readSensorData();
+}
+
+// reads made too soon after a full read, which should come from the cache
+static void benchmarkCachedReads(const char *type, DHT &dht) {
+	PathResult result = PathResult();
+
+	delay(dht.getMinSampleDelayMillis());
+	dht.readSensorData();
+	for (int i = 0; i < NUM_READS; i++) {
+		timeRead(dht, result);
+	}
+	report(type, "cached", result);
+}
+
+// the very first read of a sensor, which waits longer before its start signal
+static void benchmarkFirstRead(const char *type, uint8_t sensorType) {
+	PathResult result = PathResult();
+
+	for (int i = 0; i < NUM_READS; i++) {
+		DHT dht(SENSOR_PIN, sensorType);
+		dht.begin();
+		delay(dht.getMinSampleDelayMillis());
+		timeRead(dht, result);
+	}
+	report(type, "first", result);
+}
+
+// non-blocking reads; here the blocking time that matters is that of the
+// longest single call to poll(), which is the one that reads the data
+static void benchmarkPolledReads(const char *type, DHT &dht) {
+	PathResult result = PathResult();
+	uint64_t start, elapsed;
+	double hostStart;
+	MockStats stats;
+	uint8_t status;
+
+	for (int i = 0; i < NUM_READS; i++) {
+		delay(dht.getMinSampleDelayMillis());
+		resetMockStats();
+		dht.startRead();
+		do {
+			delayMicroseconds(100);
+			start = getMockTimeMicros();
+			hostStart = nowSeconds();
+			status = dht.poll();
+			result.hostSeconds += nowSeconds() - hostStart;
+			elapsed = getMockTimeMicros() - start;
+			result.totalMicros += elapsed;
+			if (elapsed > result.maxMicros) {
+				result.maxMicros = elapsed;
+			}
+		} while (status == DHT_READ_IN_PROGRESS);
+		stats = getMockStats();
+
+		result.reads++;
+		if (status == DHT_READ_OK) {
+			result.ok++;
+		}
+		if (stats.maxInterruptsOffMicros > result.maxInterruptsOffMicros) {
+			result.maxInterruptsOffMicros = stats.maxInterruptsOffMicros;
+		}
+		result.digitalReads += stats.digitalReads;
+	}
+	report(type, "poll", result);
+}
+
+// the decoding work alone, on the signals from a good read
+static void benchmarkDecode(const char *type, DHT &dht) {
+	PathResult result = PathResult();
+	uint8_t pulses[DHT_NUM_PULSES];
+	uint8_t data[DHT_NUM_BYTES];
+	double hostStart;
+
+	delay(dht.getMinSampleDelayMillis());
+	dht.readSensorData();
+	for (int i = 0; i < DHT_NUM_PULSES; i++) {
+		pulses[i] = dht.getPulseWidths()[i];
+	}
+
+	hostStart = nowSeconds();
+	for (int i = 0; i < NUM_DECODES; i++) {
+		// keep the compiler from hoisting the work out of the loop
+		pulses[3] ^= (uint8_t)(i & 1);
+		if (DHT::decodePulses(pulses, data)) {
+			result.ok++;
+		}
+	}
+	result.hostSeconds = nowSeconds() - hostStart;
+	result.reads = NUM_DECODES;
+	report(type, "decode", result);
+}
+
+// decoding frames in bulk, as a gateway would, from a good read with a
+// corrupted copy mixed in now and then
+static void benchmarkBatchDecode(const char *type, DHT &dht) {
+	PathResult result = PathResult();
+	static DHTFrame frames[NUM_BATCH_FRAMES];
+	static int16_t temperatures[NUM_BATCH_FRAMES], humidities[NUM_BATCH_FRAMES];
+	DHTFrame frame;
+	double hostStart;
+
+	delay(dht.getMinSampleDelayMillis());
+	dht.readSensorData(frame);
+	for (int i = 0; i < NUM_BATCH_FRAMES; i++) {
+		frames[i] = frame;
+		frames[i].data[1] += (i % 7 == 0);
+	}
+
+	hostStart = nowSeconds();
+	for (int i = 0; i < NUM_DECODES / NUM_BATCH_FRAMES; i++) {
+		result.ok += DHTFrame::decodeBatch(frames, NUM_BATCH_FRAMES, temperatures, humidities);
+	}
+	result.hostSeconds = nowSeconds() - hostStart;
+	result.reads = NUM_DECODES;
+	report(type, "batch_decode", result);
+}
+
+// reads done by interrupt handlers; the main loop never blocks at all, so
+// what matters is the longest any handler keeps interrupts off, and the
+// host time is that of the whole background read
+static DHTAsync *asyncSensor_;
+static void asyncEdgeHandler() {
+	asyncSensor_->handleEdge();
+}
+static void asyncTimerHandler() {
+	asyncSensor_->timerTick();
+}
+
+static void benchmarkAsyncReads(const char *type, uint8_t sensorType) {
+	PathResult result = PathResult();
+	DHTAsync dht(SENSOR_PIN, sensorType);
+	uint8_t frames;
+	double hostStart;
+	MockStats stats;
+
+	asyncSensor_ = &dht;
+	dht.begin(asyncEdgeHandler);
+	setTimerInterrupt(asyncTimerHandler, 1000);
+	delay(DHT_FIRST_START_DELAY + dht.getMinSampleDelayMillis()/2);
+
+	resetMockStats();
+	hostStart = nowSeconds();
+	for (int i = 0; i < NUM_READS; i++) {
+		frames = dht.getFrameCount();
+		delay(dht.getMinSampleDelayMillis());
+		result.reads++;
+		if (dht.getFrameCount() != frames && dht.getStatus() == DHT_READ_OK) {
+			result.ok++;
+		}
+	}
+	result.hostSeconds = nowSeconds() - hostStart;
+	stats = getMockStats();
+	result.maxInterruptsOffMicros = stats.maxInterruptsOffMicros;
+	result.digitalReads = stats.digitalReads;
+	report(type, "async", result);
+
+	setTimerInterrupt(NULL, 0);
+	detachInterrupt(digitalPinToInterrupt(SENSOR_PIN));
+}
+
+// asking for every value each time through loop(), in between reads, with
+// a call per value and then with readAll()
+static void benchmarkReadAll(const char *type, DHT &dht) {
+	PathResult each = PathResult(), all = PathResult();
+	DHTReading reading;
+	volatile float sink;
+	double hostStart;
+
+	delay(dht.getMinSampleDelayMillis());
+	dht.readSensorData();
+
+	hostStart = nowSeconds();
+	for (int i = 0; i < NUM_DECODES; i++) {
+		sink = dht.readTemperatureCelsius() + dht.readPercentHumidity() + dht.readTemperatureFahrenheit() +
+			dht.readHeatIndexCelsius() + dht.readHeatIndexFahrenheit();
+	}
+	each.hostSeconds = nowSeconds() - hostStart;
+	each.reads = each.ok = NUM_DECODES;
+	report(type, "read_each", each);
+
+	hostStart = nowSeconds();
+	for (int i = 0; i < NUM_DECODES; i++) {
+		dht.readAll(reading);
+		sink = reading.getTemperatureCelsius() + reading.getPercentHumidity() + reading.getTemperatureFahrenheit() +
+			reading.getHeatIndexCelsius() + reading.getHeatIndexFahrenheit();
+	}
+	all.hostSeconds = nowSeconds() - hostStart;
+	all.reads = all.ok = NUM_DECODES;
+	report(type, "read_all", all);
+	(void)sink;
+}
+
+// reads replayed from a trace of jittery recordings, looping through it a
+// few times, to see what a large corpus of real-world reads costs to run
+static void benchmarkTraceReads(const char *type, DHT &dht, uint8_t sensorType, int bitFormat) {
+	PathResult result = PathResult();
+	uint8_t *trace = new uint8_t[MOCK_TRACE_HEADER_SIZE + NUM_TRACE_RECORDS * MOCK_TRACE_MAX_RECORD_SIZE];
+	uint8_t bytes[DHT_NUM_BYTES] = {2, 55, 0, 234, 35};
+	uint32_t ticks[MOCK_TRACE_EDGES_PER_READ];
+	unsigned long length;
+	int pulse, bit, micros_;
+
+	if (bitFormat == 8) {
+		bytes[0] = 57;
+		bytes[1] = 0;
+		bytes[2] = 23;
+		bytes[3] = 0;
+		bytes[4] = 80;
+	}
+
+	// every signal off by up to 4 microseconds either way
+	srand(1357);
+	length = writeTraceHeader(trace, sensorType, TRACE_TICKS_PER_MICRO);
+	for (int i = 0; i < NUM_TRACE_RECORDS; i++) {
+		ticks[0] = 30 * TRACE_TICKS_PER_MICRO;
+		for (pulse = 0; pulse < MOCK_TRACE_EDGES_PER_READ-1; pulse++) {
+			bit = (pulse-3) / 2;
+			micros_ = (pulse < 2) ? 80 : (pulse % 2 == 0) ? 50 : (bytes[bit/8] & (0x80 >> (bit%8))) ? 70 : 26;
+			ticks[pulse+1] = micros_ * TRACE_TICKS_PER_MICRO + rand() % (8*TRACE_TICKS_PER_MICRO + 1) - 4*TRACE_TICKS_PER_MICRO;
+		}
+		length += writeTraceRecord(trace + length, ticks, MOCK_TRACE_EDGES_PER_READ);
+	}
+
+	setSensorTrace(SENSOR_PIN, trace, length);
+	for (int i = 0; i < NUM_TRACE_READS; i++) {
+		delay(dht.getMinSampleDelayMillis());
+		timeRead(dht, result);
+	}
+	setSensorTrace(SENSOR_PIN, NULL, 0);
+	delete[] trace;
+	report(type, "trace_replay", result);
+}
+
+static void benchmarkType(const char *type, uint8_t sensorType, int bitFormat) {
+	DHT dht(SENSOR_PIN, sensorType);
+
+	setSensorValues(SENSOR_PIN, 23.4, 56.7, bitFormat);
+	dht.begin();
+
+	benchmarkFirstRead(type, sensorType);
+
+	// get this instance's own first read out of the way
+	delay(dht.getMinSampleDelayMillis());
+	dht.readSensorData();
+
+	benchmarkReads(type, "blocking", dht, MOCK_FAULT_NONE, 0, 0);
+	benchmarkCachedReads(type, dht);
+	benchmarkPolledReads(type, dht);
+	benchmarkNoResponse(type, dht);
+	benchmarkReads(type, "stalled", dht, MOCK_FAULT_STRETCHED_PULSE, 40, 300);
+	benchmarkReads(type, "checksum_error", dht, MOCK_FAULT_CORRUPT_BIT, 20, 0);
+	benchmarkTraceReads(type, dht, sensorType, bitFormat);
+	benchmarkDecode(type, dht);
+	benchmarkBatchDecode(type, dht);
+	benchmarkReadAll(type, dht);
+	benchmarkAsyncReads(type, sensorType);
+}
+
+int main(int argc, char** argv) {
+	benchmarkType("DHT11", DHT_SENSOR_TYPE_DHT11, 8);
+	benchmarkType("DHT21", DHT_SENSOR_TYPE_DHT21, 16);
+	benchmarkType("DHT22", DHT_SENSOR_TYPE_DHT22, 16);
+	return 0;
+}
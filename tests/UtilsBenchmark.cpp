@@ -0,0 +1,150 @@
+// Benchmark comparing the single-value and batched DHT_TempHumidUtils
+// functions, which also checks that they produce bit-identical results
+//
+// Written by Joe Ibershoff, released under MIT license
+
+#include "DHT_TempHumidUtils.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#define NUM_SAMPLES (1<<20)
+#define NUM_ROUNDS 10
+
+
+static double nowSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double scalarSeconds, double batchSeconds, const float *scalarOut, const float *batchOut) {
+	size_t mismatches = 0;
+	double samples = (double)NUM_SAMPLES * NUM_ROUNDS;
+
+	for (size_t i = 0; i < NUM_SAMPLES; i++) {
+		if (memcmp(&scalarOut[i], &batchOut[i], sizeof(float)) != 0) {
+			mismatches++;
+		}
+	}
+
+	printf("%-28s scalar: %8.1f Msamples/s     batch: %8.1f Msamples/s     speedup: %5.2fx     mismatches: %zu\n",
+		name, samples / scalarSeconds / 1e6, samples / batchSeconds / 1e6, scalarSeconds / batchSeconds, mismatches);
+}
+
+int main(int argc, char** argv) {
+	float *temperatures = new float[NUM_SAMPLES];
+	float *humidities = new float[NUM_SAMPLES];
+	float *scalarOut = new float[NUM_SAMPLES];
+	float *batchOut = new float[NUM_SAMPLES];
+	double start, scalarSeconds, batchSeconds;
+	int round;
+	size_t i;
+
+	// temperatures from -40F to 140F, and humidities from 0% to 100%, in the
+	// tenths steps a sensor would report; this covers every branch of the
+	// heat index calculation
+	srand(12345);
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		temperatures[i] = (rand() % 1801 - 400) / 10.0;
+		humidities[i] = (rand() % 1001) / 10.0;
+	}
+
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		for (i = 0; i < NUM_SAMPLES; i++) {
+			scalarOut[i] = DHT_TempHumidUtils::computeHeatIndexFahrenheit(temperatures[i], humidities[i]);
+		}
+	}
+	scalarSeconds = nowSeconds() - start;
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		DHT_TempHumidUtils::computeHeatIndexFahrenheitBatch(temperatures, humidities, batchOut, NUM_SAMPLES);
+	}
+	batchSeconds = nowSeconds() - start;
+	report("computeHeatIndexFahrenheit", scalarSeconds, batchSeconds, scalarOut, batchOut);
+
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		for (i = 0; i < NUM_SAMPLES; i++) {
+			scalarOut[i] = DHT_TempHumidUtils::computeHeatIndexCelsius(temperatures[i], humidities[i]);
+		}
+	}
+	scalarSeconds = nowSeconds() - start;
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		DHT_TempHumidUtils::computeHeatIndexCelsiusBatch(temperatures, humidities, batchOut, NUM_SAMPLES);
+	}
+	batchSeconds = nowSeconds() - start;
+	report("computeHeatIndexCelsius", scalarSeconds, batchSeconds, scalarOut, batchOut);
+
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		for (i = 0; i < NUM_SAMPLES; i++) {
+			scalarOut[i] = DHT_TempHumidUtils::convertCelsiusToFahrenheit(temperatures[i]);
+		}
+	}
+	scalarSeconds = nowSeconds() - start;
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		DHT_TempHumidUtils::convertCelsiusToFahrenheitBatch(temperatures, batchOut, NUM_SAMPLES);
+	}
+	batchSeconds = nowSeconds() - start;
+	report("convertCelsiusToFahrenheit", scalarSeconds, batchSeconds, scalarOut, batchOut);
+
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		for (i = 0; i < NUM_SAMPLES; i++) {
+			scalarOut[i] = DHT_TempHumidUtils::convertFahrenheitToCelsius(temperatures[i]);
+		}
+	}
+	scalarSeconds = nowSeconds() - start;
+	start = nowSeconds();
+	for (round = 0; round < NUM_ROUNDS; round++) {
+		DHT_TempHumidUtils::convertFahrenheitToCelsiusBatch(temperatures, batchOut, NUM_SAMPLES);
+	}
+	batchSeconds = nowSeconds() - start;
+	report("convertFahrenheitToCelsius", scalarSeconds, batchSeconds, scalarOut, batchOut);
+
+	// the fixed point dew point and absolute humidity have no batched
+	// versions, so just time them on their own
+	{
+		int16_t *tenthsTemperatures = new int16_t[NUM_SAMPLES];
+		int16_t *tenthsHumidities = new int16_t[NUM_SAMPLES];
+		long long checksum = 0;
+
+		for (i = 0; i < NUM_SAMPLES; i++) {
+			tenthsTemperatures[i] = rand() % 1201 - 400;
+			tenthsHumidities[i] = rand() % 1001;
+		}
+		start = nowSeconds();
+		for (round = 0; round < NUM_ROUNDS; round++) {
+			for (i = 0; i < NUM_SAMPLES; i++) {
+				checksum += DHT_TempHumidUtils::computeDewPointTenthsCelsius(tenthsTemperatures[i], tenthsHumidities[i]);
+			}
+		}
+		scalarSeconds = nowSeconds() - start;
+		printf("%-28s scalar: %8.1f Msamples/s     (checksum %lld)\n", "computeDewPointTenthsCelsius",
+			(double)NUM_SAMPLES * NUM_ROUNDS / scalarSeconds / 1e6, checksum);
+
+		start = nowSeconds();
+		for (round = 0; round < NUM_ROUNDS; round++) {
+			for (i = 0; i < NUM_SAMPLES; i++) {
+				checksum += DHT_TempHumidUtils::computeAbsoluteHumidityTenths(tenthsTemperatures[i], tenthsHumidities[i]);
+			}
+		}
+		scalarSeconds = nowSeconds() - start;
+		printf("%-28s scalar: %8.1f Msamples/s     (checksum %lld)\n", "computeAbsoluteHumidityTenths",
+			(double)NUM_SAMPLES * NUM_ROUNDS / scalarSeconds / 1e6, checksum);
+
+		delete[] tenthsTemperatures;
+		delete[] tenthsHumidities;
+	}
+
+	delete[] temperatures;
+	delete[] humidities;
+	delete[] scalarOut;
+	delete[] batchOut;
+	return 0;
+}
@@ -1,5 +1,8 @@
 #include "WProgram.h"
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /***************************************************************************
  * special-purpose mock Arduino environment
@@ -15,114 +18,665 @@
  ***************************************************************************/
 
 
+#define MOCK_NUM_PORTS 8
+#define MOCK_NUM_PINS (MOCK_NUM_PORTS*8)
+
+// the sensor's signals, numbered as in DHT::getPulseWidths(): the response's
+// LOW and HIGH, a LOW and HIGH for each of the 40 bits, and a final LOW
+#define MOCK_NUM_SENSOR_PULSES 83
+
+#define MOCK_START_SIGNAL_MICROS_8BIT  18000
+#define MOCK_START_SIGNAL_MICROS_16BIT 1000
+
+// the first bytes of a trace, and the sensor type in its header that needs
+// the longer start signal (DHT_SENSOR_TYPE_DHT11)
+#define MOCK_TRACE_MAGIC "DHTTRACE"
+#define MOCK_TRACE_TYPE_8BIT 11
+
+// the values a sensor is set to send
+struct MockSensorValues {
+	boolean set;
+	float celsius;
+	float humidity;
+	int bitFormat;
+};
+
+// everything about one pin: what the host is doing with it, and what the
+// sensor attached to it is doing
+struct MockPin {
+	// host side
+	unsigned int mode;
+	unsigned int latch;
+	boolean hostLow;
+	uint64_t hostLowSince;
+
+	// sensor side
+	MockSensorValues values;
+	boolean sensorLow;
+	uint8_t frame[5];
+	int nextPulse;
+	uint64_t nextEdge;
+	int queueIndex;
+	unsigned long responses;
+	int timeScalePercent;
+
+	int fault;
+	int faultPosition;
+	long faultExtraMicros;
+	int faultReads;
+
+	// a trace being replayed instead of the values (see setSensorTrace()),
+	// the next record to replay, and the edges left in the one being
+	// replayed; edge times are kept in ticks, scaled by timeScalePercent,
+	// from the moment the host let go of the line
+	const uint8_t *trace;
+	uint8_t *traceCopy;
+	unsigned long traceLength;
+	unsigned long traceOffset;
+	boolean traceLoop;
+	const uint8_t *traceNext;
+	const uint8_t *traceEnd;
+	uint64_t traceStart;
+	uint64_t traceTicks;
+
+	// the external interrupt on this pin
+	void (*handler)();
+	boolean interruptPending;
+};
+
+
+// everything one simulation keeps track of; see createMockEnvironment()
+struct MockEnvironment {
+	boolean initialized;
+	uint64_t timeMicros;
+
+	MockPin pins[MOCK_NUM_PINS];
+	MockSensorValues defaultValues;
+
+	// a min-heap of the pins whose sensors have an edge coming up, ordered
+	// by the time of that edge
+	uint8_t queue[MOCK_NUM_PINS];
+	int queueSize;
+
+	volatile uint8_t portInputRegisters[MOCK_NUM_PORTS];
+
+	MockStats stats;
+	boolean interruptsOff;
+	uint64_t interruptsOffSince;
+
+	void (*timerHandler)();
+	unsigned long timerPeriod;
+	uint64_t nextTimerFire;
+	boolean timerPending;
+
+	// set while processEvents() is working through the queue, and while a
+	// handler runs, so that the mock functions a handler calls don't start
+	// processing events (or running handlers) of their own
+	boolean processingEvents;
+	boolean inHandler;
+};
+
+
 // internal values
-static unsigned long timeMillis_ = 12345;
-static unsigned long timeMicros_ = 12345678;
-static unsigned int remainderTimeMicros_ = 678;
 
-static unsigned short signals_[85];
-static int durations_[85];
-static int index_ = -1;
-static unsigned long nextTransition_;
-static unsigned long wrapFrom_ = 0;
+// each thread's own environment, and the one it's using (NULL for its own)
+static thread_local MockEnvironment threadEnvironment_;
+static thread_local MockEnvironment *environment_ = NULL;
 
+static void processEvents();
+static void updateHost(unsigned int pin);
 
 
-// mock I/O functions
 
-void pinMode(unsigned int pin, unsigned int mode) {
-	delayMicroseconds(2);
+// internal helpers
 
-	if (mode == INPUT && index_ >= 0) {
-		// reset internal values to start over on sensor output values
-		wrapFrom_ = micros();
-		index_ = 0;
-		nextTransition_ = wrapFrom_+durations_[0];
-		if (wrapFrom_ <= nextTransition_) {
-			wrapFrom_ = 0;
-		}
+static void initializeEnvironment(MockEnvironment &env) {
+	memset(&env, 0, sizeof(env));
+	env.initialized = true;
+	env.timeMicros = 12345678;
+	for (int pin=0; pin<MOCK_NUM_PINS; pin++) {
+		env.pins[pin].mode = INPUT;
+		env.pins[pin].queueIndex = -1;
+		env.pins[pin].timeScalePercent = 100;
+	}
+	for (int port=0; port<MOCK_NUM_PORTS; port++) {
+		env.portInputRegisters[port] = 0xFF;
 	}
 }
 
-void digitalWrite(unsigned int pin, unsigned int value) {
-	delayMicroseconds(5);
+static inline MockEnvironment& environment() {
+	if (environment_) {
+		return *environment_;
+	}
+	if (!threadEnvironment_.initialized) {
+		initializeEnvironment(threadEnvironment_);
+	}
+	return threadEnvironment_;
 }
 
-unsigned int digitalRead(unsigned int pin) {
-	delayMicroseconds(5);
+static inline MockPin* getPin(unsigned int pin) {
+	return (pin < MOCK_NUM_PINS) ? &environment().pins[pin] : NULL;
+}
 
-	unsigned long currentTime;
+static inline unsigned int lineLevel(const MockPin &p) {
+	// either side can pull the line LOW; otherwise the pull-up wins
+	return (p.hostLow || p.sensorLow) ? LOW : HIGH;
+}
 
-	currentTime = micros();
+// runs an interrupt handler now, with interrupts off, counting the time it
+// takes as time with interrupts off
+static void runHandler(void (*handler)()) {
+	MockEnvironment &env = environment();
+	uint64_t start = env.timeMicros, offMicros;
+
+	env.interruptsOff = true;
+	env.inHandler = true;
+	handler();
+	env.inHandler = false;
+	env.interruptsOff = false;
+
+	offMicros = env.timeMicros - start;
+	env.stats.interruptsOffMicros += offMicros;
+	if (offMicros > env.stats.maxInterruptsOffMicros) {
+		env.stats.maxInterruptsOffMicros = offMicros;
+	}
+}
+
+// the line on a pin has just fallen
+static void lineFell(unsigned int pin) {
+	MockEnvironment &env = environment();
+	MockPin &p = env.pins[pin];
+
+	if (!p.handler) {
+		return;
+	}
+	if (env.interruptsOff) {
+		p.interruptPending = true;
+	} else {
+		runHandler(p.handler);
+	}
+}
 
-	// move through the transitions until we "find" the current time or a
-	// special negative duration; a duration < 0 means stay on the current
-	// value forever
-	while (durations_[index_] >= 0 && (nextTransition_ < currentTime || wrapFrom_)) {
-		if (wrapFrom_) {
-			// if wrapFrom_ is set, then we need to see a wrap before we check
-			// against the nextTransition_ value
+static void runPendingHandlers() {
+	MockEnvironment &env = environment();
 
-			if (currentTime > wrapFrom_) {
-				// we haven't see the wrap yet
-				return signals_[index_];
+	for (int pin=0; pin<MOCK_NUM_PINS && !env.interruptsOff; pin++) {
+		if (env.pins[pin].interruptPending) {
+			env.pins[pin].interruptPending = false;
+			if (env.pins[pin].handler) {
+				runHandler(env.pins[pin].handler);
 			}
+		}
+	}
+	if (env.timerPending && !env.interruptsOff) {
+		env.timerPending = false;
+		if (env.timerHandler) {
+			runHandler(env.timerHandler);
+		}
+	}
+}
+
+static void updatePortRegister(unsigned int pin) {
+	MockEnvironment &env = environment();
+	uint8_t mask = digitalPinToBitMask(pin);
+
+	if (lineLevel(env.pins[pin]) == HIGH) {
+		env.portInputRegisters[digitalPinToPort(pin)] |= mask;
+	} else {
+		env.portInputRegisters[digitalPinToPort(pin)] &= ~mask;
+	}
+}
+
+static void swapQueueEntries(int a, int b) {
+	MockEnvironment &env = environment();
+	uint8_t pin = env.queue[a];
+
+	env.queue[a] = env.queue[b];
+	env.queue[b] = pin;
+	env.pins[env.queue[a]].queueIndex = a;
+	env.pins[env.queue[b]].queueIndex = b;
+}
+
+static void siftUp(int index) {
+	MockEnvironment &env = environment();
+
+	while (index > 0 && env.pins[env.queue[index]].nextEdge < env.pins[env.queue[(index-1)/2]].nextEdge) {
+		swapQueueEntries(index, (index-1)/2);
+		index = (index-1)/2;
+	}
+}
+
+static void siftDown(int index) {
+	MockEnvironment &env = environment();
+	int child;
+
+	while ((child = 2*index + 1) < env.queueSize) {
+		if (child+1 < env.queueSize && env.pins[env.queue[child+1]].nextEdge < env.pins[env.queue[child]].nextEdge) {
+			child++;
+		}
+		if (env.pins[env.queue[index]].nextEdge <= env.pins[env.queue[child]].nextEdge) {
+			break;
+		}
+		swapQueueEntries(index, child);
+		index = child;
+	}
+}
+
+static void enqueue(unsigned int pin) {
+	MockEnvironment &env = environment();
+
+	env.pins[pin].queueIndex = env.queueSize;
+	env.queue[env.queueSize++] = pin;
+	siftUp(env.queueSize-1);
+}
+
+static void dequeue(unsigned int pin) {
+	MockEnvironment &env = environment();
+	int index = env.pins[pin].queueIndex;
+
+	if (index < 0) {
+		return;
+	}
+	swapQueueEntries(index, --env.queueSize);
+	env.pins[pin].queueIndex = -1;
+	if (index < env.queueSize) {
+		siftUp(index);
+		siftDown(index);
+	}
+}
+
+static const MockSensorValues& sensorValues(const MockPin &p) {
+	return p.values.set ? p.values : environment().defaultValues;
+}
+
+// the bytes the sensor sends, in the order it sends them
+static void encodeFrame(const MockSensorValues &values, uint8_t *frame) {
+	unsigned long bits=0;
+	unsigned int checksum=0;
+
+	switch (values.bitFormat) {
+		case 8:
+			bits |= (((unsigned short)round(values.humidity))&0xFF)<<24;
+			bits |= (((unsigned short)round(values.celsius))&0xFF)<<8;
+			break;
+		case 16:
+			bits |= (((unsigned long)round(values.humidity*10.0))&0xFFFF)<<16;
+			// negative temperatures are transmitted using 1s-complement integer
+			// format, so we mask off the highest-order bit
+			bits |= (((unsigned long)fabs(round(values.celsius*10.0)))&0x7FFF)<<0;
+			// and then we need to drop in the sign bit
+			bits |= (values.celsius < 0 ? 0x1 : 0x0)<<15;
+			break;
+	}
+
+	for (int i=0; i<4; i++) {
+		frame[i] = (bits >> (24 - 8*i)) & 0xFF;
+		checksum += frame[i];
+	}
+	frame[4] = checksum & 0xFF;
+}
+
+static uint32_t readVarint(const uint8_t *&data, const uint8_t *end) {
+	uint32_t value = 0;
+	int shift = 0;
+
+	while (data < end) {
+		uint8_t byte = *data++;
+		if (shift < 32) {
+			value |= (uint32_t)(byte & 0x7F) << shift;
+		}
+		if (!(byte & 0x80)) {
+			break;
+		}
+		shift += 7;
+	}
+	return value;
+}
+
+static unsigned int writeVarint(uint8_t *out, uint32_t value) {
+	unsigned int length = 0;
+
+	while (value >= 0x80) {
+		out[length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	out[length++] = value;
+	return length;
+}
+
+static boolean faultActive(const MockPin &p, int fault) {
+	return p.fault == fault && p.faultReads != 0;
+}
+
+static long pulseLength(const MockPin &p, int pulse) {
+	long length;
+	int bit;
+
+	if (pulse < 2) {
+		length = 80;
+	} else if (pulse % 2 == 0) {
+		length = 50;
+	} else {
+		bit = (pulse-3) / 2;
+		length = (p.frame[bit/8] & (0x80 >> (bit%8))) ? 70 : 26;
+	}
+	length = length * p.timeScalePercent / 100;
+	if (faultActive(p, MOCK_FAULT_STRETCHED_PULSE) && pulse == p.faultPosition) {
+		length += p.faultExtraMicros;
+	}
+	return length;
+}
+
+// when the next edge of the trace being replayed happens
+static void scheduleTraceEdge(MockPin &p) {
+	p.traceTicks += (uint64_t)readVarint(p.traceNext, p.traceEnd) * p.timeScalePercent;
+	p.nextEdge = p.traceStart + p.traceTicks / ((uint64_t)p.trace[10] * 100);
+}
+
+// the host has released the line after a start signal, and the sensor is
+// replaying a trace
+static void startTraceResponse(unsigned int pin, uint64_t startLength) {
+	MockEnvironment &env = environment();
+	MockPin &p = env.pins[pin];
+	const uint8_t *record;
+	uint32_t length;
+
+	if (startLength < (p.trace[9] == MOCK_TRACE_TYPE_8BIT ? MOCK_START_SIGNAL_MICROS_8BIT : MOCK_START_SIGNAL_MICROS_16BIT)) {
+		// too short to wake the sensor up
+		return;
+	}
+	if (p.traceOffset >= p.traceLength) {
+		if (!p.traceLoop) {
+			return;
+		}
+		p.traceOffset = MOCK_TRACE_HEADER_SIZE;
+	}
+
+	// setSensorTrace() made sure every record fits in the trace
+	record = p.trace + p.traceOffset;
+	length = readVarint(record, p.trace + p.traceLength);
+	p.traceNext = record;
+	p.traceEnd = record + length;
+	p.traceOffset = p.traceEnd - p.trace;
+	if (p.traceNext == p.traceEnd) {
+		// a read the sensor never answered
+		return;
+	}
+
+	p.responses++;
+	p.traceStart = env.timeMicros;
+	p.traceTicks = 0;
+	scheduleTraceEdge(p);
+	enqueue(pin);
+}
+
+// the host has released the line after a start signal
+static void startResponse(unsigned int pin) {
+	MockEnvironment &env = environment();
+	MockPin &p = env.pins[pin];
+	const MockSensorValues &values = sensorValues(p);
+	uint64_t startLength = env.timeMicros - p.hostLowSince;
+
+	if (faultActive(p, MOCK_FAULT_NO_RESPONSE)) {
+		if (p.faultReads > 0) {
+			p.faultReads--;
+		}
+		return;
+	}
+	if (p.trace) {
+		startTraceResponse(pin, startLength);
+		return;
+	}
+	if (!values.set) {
+		// nothing attached to this pin
+		return;
+	}
+	if (startLength < (values.bitFormat == 8 ? MOCK_START_SIGNAL_MICROS_8BIT : MOCK_START_SIGNAL_MICROS_16BIT)) {
+		// too short to wake the sensor up
+		return;
+	}
+
+	encodeFrame(values, p.frame);
+	if (faultActive(p, MOCK_FAULT_CORRUPT_BIT)) {
+		p.frame[p.faultPosition/8] ^= 0x80 >> (p.faultPosition%8);
+	}
+	p.responses++;
+	p.nextPulse = 0;
+	p.nextEdge = env.timeMicros + MOCK_RESPONSE_DELAY_MICROS;
+	enqueue(pin);
+}
+
+// the sensor on this pin has reached its next edge
+static void sensorEdge(unsigned int pin) {
+	MockEnvironment &env = environment();
+	MockPin &p = env.pins[pin];
+	unsigned int level = lineLevel(p);
+
+	if (!p.trace && faultActive(p, MOCK_FAULT_DROPPED_BIT) && p.nextPulse == 2 + 2*p.faultPosition) {
+		p.nextPulse += 2;
+	}
+
+	if (p.trace) {
+		// every event in a trace is an edge, whichever way it goes
+		p.sensorLow = !p.sensorLow;
+		if (p.traceNext < p.traceEnd) {
+			scheduleTraceEdge(p);
+			siftDown(p.queueIndex);
+		} else {
+			dequeue(pin);
+		}
+	} else if (p.nextPulse >= MOCK_NUM_SENSOR_PULSES) {
+		// all done; let the line go
+		p.sensorLow = false;
+		dequeue(pin);
+		if (p.faultReads > 0) {
+			p.faultReads--;
+		}
+	} else {
+		p.sensorLow = (p.nextPulse % 2 == 0);
+		p.nextEdge += pulseLength(p, p.nextPulse);
+		p.nextPulse++;
+		siftDown(p.queueIndex);
+	}
+	updatePortRegister(pin);
+	if (level == HIGH && lineLevel(p) == LOW) {
+		lineFell(pin);
+	}
+}
 
-			// we must have wrapped; reset the wrapFrom_ value and continue
-			wrapFrom_ = 0;
+// let everything that should have happened by now happen, in order: sensor
+// edges, and the timer interrupt.  Each one happens with the clock set to
+// its own time, so that a handler sees the time it was triggered (or a bit
+// later, if an earlier handler ran long).
+static void processEvents() {
+	MockEnvironment &env = environment();
+	uint64_t now = env.timeMicros, busyUntil = 0, next;
+	boolean timerNext;
+
+	if (env.processingEvents || env.inHandler) {
+		return;
+	}
+	env.processingEvents = true;
+	while (true) {
+		timerNext = env.timerHandler && (env.queueSize == 0 || env.nextTimerFire < env.pins[env.queue[0]].nextEdge);
+		if (timerNext) {
+			next = env.nextTimerFire;
+		} else if (env.queueSize > 0) {
+			next = env.pins[env.queue[0]].nextEdge;
+		} else {
+			break;
+		}
+		if (next > now) {
+			break;
 		}
+		env.timeMicros = (next > busyUntil) ? next : busyUntil;
+
+		if (timerNext) {
+			env.nextTimerFire += env.timerPeriod;
+			if (env.interruptsOff) {
+				env.timerPending = true;
+			} else {
+				runHandler(env.timerHandler);
+			}
+		} else {
+			sensorEdge(env.queue[0]);
+		}
+		busyUntil = env.timeMicros;
+	}
+	if (busyUntil > now) {
+		now = busyUntil;
+	}
+	env.timeMicros = now;
+	env.processingEvents = false;
+}
 
-		// move on to the next signal definition
-		index_++;
-		wrapFrom_ = nextTransition_;
-		nextTransition_ += durations_[index_];
-		// check if we need to watch for a wrap...  this could also happen if
-		// the duration is < 0, but we don't care because that's a special
-		// case that is handled separately anyway
-		if (wrapFrom_ <= nextTransition_) {
-			wrapFrom_ = 0;
+// recompute whether the host is pulling the line LOW, and react to the start
+// and end of a start signal
+static void updateHost(unsigned int pin) {
+	MockEnvironment &env = environment();
+	MockPin &p = env.pins[pin];
+	boolean hostLow = (p.mode == OUTPUT && p.latch == LOW);
+	unsigned int level = lineLevel(p);
+
+	if (hostLow && !p.hostLow) {
+		// a new start signal; a sensor in the middle of sending would be
+		// thrown off by this, so it gives up
+		p.hostLowSince = env.timeMicros;
+		if (p.queueIndex >= 0) {
+			dequeue(pin);
 		}
+		p.sensorLow = false;
+	}
+	if (!hostLow && p.hostLow) {
+		p.hostLow = false;
+		startResponse(pin);
+	}
+	p.hostLow = hostLow;
+	updatePortRegister(pin);
+	if (level == HIGH && lineLevel(p) == LOW) {
+		lineFell(pin);
+	}
+}
+
+
+
+// mock I/O functions
+
+void pinMode(unsigned int pin, unsigned int mode) {
+	MockEnvironment &env = environment();
+	MockPin *p = getPin(pin);
+
+	delayMicroseconds(2);
+	env.stats.pinModes++;
+
+	if (p) {
+		p->mode = mode;
+		updateHost(pin);
+	}
+}
+
+void digitalWrite(unsigned int pin, unsigned int value) {
+	MockEnvironment &env = environment();
+	MockPin *p = getPin(pin);
+
+	delayMicroseconds(5);
+	env.stats.digitalWrites++;
+
+	if (p) {
+		p->latch = value;
+		updateHost(pin);
 	}
+}
+
+unsigned int digitalRead(unsigned int pin) {
+	MockEnvironment &env = environment();
+	MockPin *p = getPin(pin);
+
+	delayMicroseconds(5);
+	env.stats.digitalReads++;
+
+	return p ? lineLevel(*p) : HIGH;
+}
 
-	return signals_[index_];
+volatile uint8_t* mockPortInputRegister(unsigned int port) {
+	return &environment().portInputRegisters[port % MOCK_NUM_PORTS];
 }
 
 
 // mock time and delay functions
 
 unsigned long millis() {
+	MockEnvironment &env = environment();
+
 	delayMicroseconds(1);
-	return timeMillis_;
+	env.stats.timeReads++;
+	return (unsigned long)(env.timeMicros/1000);
 }
 
 unsigned long micros() {
+	MockEnvironment &env = environment();
+
 	delayMicroseconds(1);
-	return timeMicros_;
+	env.stats.timeReads++;
+	return (unsigned long)env.timeMicros;
 }
 
 void delay(unsigned long milliseconds) {
-	timeMillis_ += milliseconds;
-	timeMicros_ += milliseconds*1000;
-	delayMicroseconds(1);
+	delayMicroseconds(milliseconds*1000 + 1);
 }
 
 void delayMicroseconds(unsigned long microseconds) {
-	timeMicros_ += microseconds;
-	remainderTimeMicros_ += microseconds;
-	timeMillis_ += remainderTimeMicros_/1000;
-	remainderTimeMicros_ %= 1000;
+	environment().timeMicros += microseconds;
+	processEvents();
 }
 
 
 // mock interrupt control
 
 void interrupts() {
+	MockEnvironment &env = environment();
+	uint64_t offMicros;
+
 	delayMicroseconds(3);
-	// do nothing
+	if (env.interruptsOff) {
+		env.interruptsOff = false;
+		offMicros = env.timeMicros - env.interruptsOffSince;
+		env.stats.interruptsOffMicros += offMicros;
+		if (offMicros > env.stats.maxInterruptsOffMicros) {
+			env.stats.maxInterruptsOffMicros = offMicros;
+		}
+		if (!env.inHandler) {
+			runPendingHandlers();
+		}
+	}
 }
 void noInterrupts() {
+	MockEnvironment &env = environment();
+
 	delayMicroseconds(3);
-	// do nothing
+	if (!env.interruptsOff) {
+		env.interruptsOff = true;
+		env.interruptsOffSince = env.timeMicros;
+	}
+}
+
+
+void attachInterrupt(unsigned int interrupt, void (*handler)(), int mode) {
+	MockPin *p = getPin(interrupt);
+
+	if (p && mode == FALLING) {
+		p->handler = handler;
+		p->interruptPending = false;
+	}
+}
+
+void detachInterrupt(unsigned int interrupt) {
+	MockPin *p = getPin(interrupt);
+
+	if (p) {
+		p->handler = NULL;
+		p->interruptPending = false;
+	}
 }
 
 
@@ -130,63 +684,193 @@ void noInterrupts() {
 // for mocking purposes in the testing program
 
 void setTime(unsigned long timeMillis, unsigned int remainderTimeMicros) {
-	timeMillis_ = timeMillis;
-	timeMicros_ = timeMillis*1000 + remainderTimeMicros;
-	remainderTimeMicros_ = remainderTimeMicros;
+	MockEnvironment &env = environment();
+	uint64_t newTime = (uint64_t)timeMillis*1000 + remainderTimeMicros;
+
+	// let everything that should have happened by now happen, then shift any
+	// signals still to come so they keep their place relative to the new time
+	processEvents();
+	for (int i=0; i<env.queueSize; i++) {
+		env.pins[env.queue[i]].nextEdge += newTime - env.timeMicros;
+	}
+	env.nextTimerFire += newTime - env.timeMicros;
+	for (int pin=0; pin<MOCK_NUM_PINS; pin++) {
+		env.pins[pin].hostLowSince += newTime - env.timeMicros;
+	}
+	env.timeMicros = newTime;
 }
 
 void setSensorValues(float celsius, float humidity, int bitFormat) {
-	int j=0;
-	unsigned long bits=0;
-	unsigned int checksum=0;
+	MockEnvironment &env = environment();
 
-	signals_[j] = HIGH;
-	durations_[j++] = 5;
-	signals_[j] = LOW;
-	durations_[j++] = 80;
-	signals_[j] = HIGH;
-	durations_[j++] = 80;
+	env.defaultValues.set = true;
+	env.defaultValues.celsius = celsius;
+	env.defaultValues.humidity = humidity;
+	env.defaultValues.bitFormat = bitFormat;
+}
 
-	switch (bitFormat) {
-		case 8:
-			bits |= (((unsigned short)round(humidity))&0xFF)<<24;
-			bits |= (((unsigned short)round(celsius))&0xFF)<<8;
-			break;
-		case 16:
-			bits |= (((unsigned long)round(humidity*10.0))&0xFFFF)<<16;
-			// negative temperatures are transmitted using 1s-complement integer
-			// format, so we mask off the highest-order bit
-			bits |= (((unsigned long)fabs(round(celsius*10.0)))&0x7FFF)<<0;
-			// and then we need to drop in the sign bit
-			bits |= (celsius < 0 ? 0x1 : 0x0)<<15;
-			break;
+void setSensorValues(unsigned int pin, float celsius, float humidity, int bitFormat) {
+	MockPin *p = getPin(pin);
+
+	if (p) {
+		p->values.set = true;
+		p->values.celsius = celsius;
+		p->values.humidity = humidity;
+		p->values.bitFormat = bitFormat;
+	}
+}
+
+void setSensorFault(unsigned int pin, int fault, int position, long extraMicros, int numReads) {
+	MockPin *p = getPin(pin);
+
+	if (p) {
+		p->fault = fault;
+		p->faultPosition = position;
+		p->faultExtraMicros = extraMicros;
+		p->faultReads = numReads;
+	}
+}
+
+void setSensorTimeScale(unsigned int pin, int percent) {
+	MockPin *p = getPin(pin);
+
+	if (p) {
+		p->timeScalePercent = percent;
+	}
+}
+
+unsigned long getSensorResponseCount(unsigned int pin) {
+	MockPin *p = getPin(pin);
+
+	return p ? p->responses : 0;
+}
+
+// checks the header, and that every record fits in the trace, so replay
+// doesn't have to
+static boolean validTrace(const uint8_t *trace, unsigned long length) {
+	const uint8_t *data, *end = trace + length;
+	uint32_t recordLength;
+
+	if (length < MOCK_TRACE_HEADER_SIZE || memcmp(trace, MOCK_TRACE_MAGIC, 8) != 0 || trace[8] != MOCK_TRACE_VERSION || trace[10] == 0) {
+		return false;
+	}
+	for (data = trace + MOCK_TRACE_HEADER_SIZE; data < end; data += recordLength) {
+		recordLength = readVarint(data, end);
+		if (recordLength > (unsigned long)(end - data)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void attachTrace(unsigned int pin, const uint8_t *trace, unsigned long length, boolean loop, uint8_t *copy) {
+	MockPin &p = environment().pins[pin];
+
+	// a read in progress can't carry on from a different trace
+	dequeue(pin);
+	p.sensorLow = false;
+	updatePortRegister(pin);
+
+	free(p.traceCopy);
+	p.traceCopy = copy;
+	p.trace = trace;
+	p.traceLength = length;
+	p.traceOffset = MOCK_TRACE_HEADER_SIZE;
+	p.traceLoop = loop;
+}
+
+boolean setSensorTrace(unsigned int pin, const uint8_t *trace, unsigned long length, boolean loop) {
+	if (!getPin(pin) || (trace && !validTrace(trace, length))) {
+		return false;
 	}
+	attachTrace(pin, trace, length, loop, NULL);
+	return true;
+}
 
-	checksum += (bits & (0xFF<<0))>>0;
-	checksum += (bits & (0xFF<<8))>>8;
-	checksum += (bits & (0xFF<<16))>>16;
-	checksum += (bits & (0xFF<<24))>>24;
-	checksum &= 0xFF;
+boolean loadSensorTrace(unsigned int pin, const char *path, boolean loop) {
+	FILE *file;
+	uint8_t *trace = NULL;
+	long length = -1;
 
-	// set up the signals and durations needed to transmit these values out
-	// properly to the Arduino
-	for (int i=31; i>=0; i--) {
-		signals_[j] = LOW;
-		durations_[j++] = 50;
-		signals_[j] = HIGH;
-		durations_[j++] = (bits & (0x1<<i))?70:26;
+	if (!getPin(pin) || !(file = fopen(path, "rb"))) {
+		return false;
+	}
+	if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+		trace = (uint8_t*)malloc(length ? length : 1);
 	}
-	for (int i=7; i>=0; i--) {
-		signals_[j] = LOW;
-		durations_[j++] = 50;
-		signals_[j] = HIGH;
-		durations_[j++] = (checksum & (0x1<<i))?70:26;
+	if (trace && fread(trace, 1, length, file) == (size_t)length && validTrace(trace, length)) {
+		fclose(file);
+		attachTrace(pin, trace, length, loop, trace);
+		return true;
 	}
+	fclose(file);
+	free(trace);
+	return false;
+}
 
-	signals_[j] = LOW;
-	durations_[j++] = -1;
+unsigned int writeTraceHeader(uint8_t *out, uint8_t sensorType, uint8_t ticksPerMicro) {
+	memcpy(out, MOCK_TRACE_MAGIC, 8);
+	out[8] = MOCK_TRACE_VERSION;
+	out[9] = sensorType;
+	out[10] = ticksPerMicro;
+	return MOCK_TRACE_HEADER_SIZE;
+}
+
+unsigned int writeTraceRecord(uint8_t *out, const uint32_t *ticks, unsigned int numEdges) {
+	uint8_t body[MOCK_TRACE_MAX_EDGES*5];
+	unsigned int length = 0, lengthSize;
+
+	if (numEdges > MOCK_TRACE_MAX_EDGES) {
+		numEdges = MOCK_TRACE_MAX_EDGES;
+	}
+	for (unsigned int i=0; i<numEdges; i++) {
+		length += writeVarint(body + length, ticks[i]);
+	}
+	lengthSize = writeVarint(out, length);
+	memcpy(out + lengthSize, body, length);
+	return lengthSize + length;
+}
+
+void resetMockStats() {
+	memset(&environment().stats, 0, sizeof(MockStats));
+}
 
-	index_ = 0;
-	nextTransition_ = micros()+durations_[0];
+MockStats getMockStats() {
+	return environment().stats;
 }
 
+uint64_t getMockTimeMicros() {
+	return environment().timeMicros;
+}
+
+void setTimerInterrupt(void (*handler)(), unsigned long periodMicros) {
+	MockEnvironment &env = environment();
+
+	env.timerHandler = periodMicros ? handler : NULL;
+	env.timerPeriod = periodMicros;
+	env.timerPending = false;
+	env.nextTimerFire = env.timeMicros + periodMicros;
+}
+
+MockEnvironment* createMockEnvironment() {
+	MockEnvironment *env = (MockEnvironment*)malloc(sizeof(MockEnvironment));
+
+	if (env) {
+		initializeEnvironment(*env);
+	}
+	return env;
+}
+
+void destroyMockEnvironment(MockEnvironment *env) {
+	if (env == environment_) {
+		environment_ = NULL;
+	}
+	for (int pin=0; pin<MOCK_NUM_PINS; pin++) {
+		free(env->pins[pin].traceCopy);
+	}
+	free(env);
+}
+
+void setMockEnvironment(MockEnvironment *env) {
+	environment_ = env;
+}
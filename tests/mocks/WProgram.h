@@ -33,10 +33,31 @@ void pinMode(unsigned int pin, unsigned int mode);
 void digitalWrite(unsigned int pin, unsigned int value);
 unsigned int digitalRead(unsigned int pin);
 
+// mock port registers, for code that reads pins without digitalRead(); each
+// mock port has 8 pins, and each bit reads the same as digitalRead() would
+// for that pin
+#define digitalPinToPort(pin) ((pin) / 8)
+#define digitalPinToBitMask(pin) ((uint8_t)(1 << ((pin) % 8)))
+#define portInputRegister(port) (mockPortInputRegister(port))
+volatile uint8_t* mockPortInputRegister(unsigned int port);
+
 // mock interrupt control
 void interrupts();
 void noInterrupts();
 
+// mock external interrupts; every mock pin can have one, and its interrupt
+// number is the same as its pin number.  Only FALLING is supported.  A
+// handler runs at the moment the line falls, by the mock's clock, with
+// interrupts off; if interrupts are already off, it runs as soon as they're
+// turned back on (at most once, however many times the line fell), as on
+// real hardware
+#define CHANGE	1
+#define FALLING	2
+#define RISING	3
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(unsigned int interrupt, void (*handler)(), int mode);
+void detachInterrupt(unsigned int interrupt);
+
 // mock time and delay functions
 unsigned long millis();
 unsigned long micros();
@@ -48,14 +69,119 @@ void delayMicroseconds(unsigned long microseconds);
 // for mocking purposes in the testing program
 
 // setTime() sets the current time value as returned by both millis() and
-// micros().  All of the mock functions increment the time by at least one
-// millisecond, with values somewhat arbitrarily hardcoded (except the delay
-// functions, of course).
+// micros().  All of the mock functions advance the time by at least one
+// microsecond, with values somewhat arbitrarily hardcoded (except the delay
+// functions, of course).  Time is kept in a 64-bit count of microseconds,
+// so it never wraps during a test.
 void setTime(unsigned long timeMillis, unsigned int remainderTimeMicros=0);
 
+// Each pin can have its own mock sensor attached.  A sensor answers a start
+// signal the way a real one does: once the host has held the line LOW for
+// long enough (18ms for DHT11-style sensors, 1ms for the others) and then
+// released it, the sensor waits MOCK_RESPONSE_DELAY_MICROS and sends its
+// response, its 40 data bits and a final LOW before letting the line go.
+// Sensor signals are driven by a queue of upcoming edges, so digitalRead()
+// costs the same no matter how many pins are simulated.
+#define MOCK_RESPONSE_DELAY_MICROS 50
+
 // this sets the values the sensor will return, and in addition takes a
 // bitFormat parameter that should be either 8 or 16, to indicate the width
-// of the values returned from the sensor (8 for DHT11, or 16 for DHT2*)
+// of the values returned from the sensor (8 for DHT11, or 16 for DHT2*).
+// Without a pin, the values apply to every pin that hasn't been given values
+// of its own.
 void setSensorValues(float celsius, float humidity, int bitFormat);
+void setSensorValues(unsigned int pin, float celsius, float humidity, int bitFormat);
+
+// Faults make the sensor on a pin misbehave, for numReads reads (or until
+// cleared with MOCK_FAULT_NONE if numReads < 0).  Bits are numbered 0-39 in
+// the order they are sent.  Pulses are numbered as in DHT::getPulseWidths(),
+// from the response's LOW (0) to the LOW after the last bit (82).
+#define MOCK_FAULT_NONE             0
+#define MOCK_FAULT_NO_RESPONSE      1   // ignore start signals entirely
+#define MOCK_FAULT_DROPPED_BIT      2   // never send bit <position>
+#define MOCK_FAULT_STRETCHED_PULSE  3   // make pulse <position> extraMicros longer
+#define MOCK_FAULT_CORRUPT_BIT      4   // flip bit <position>, but not the checksum
+void setSensorFault(unsigned int pin, int fault, int position=0, long extraMicros=0, int numReads=-1);
+
+// makes the sensor on a pin send every signal at the given percentage of its
+// usual length, like a sensor (or a host clock) that runs slow or fast
+void setSensorTimeScale(unsigned int pin, int percent);
+
+// the number of start signals the sensor on a pin has answered
+unsigned long getSensorResponseCount(unsigned int pin);
+
+// Instead of sending its values, the sensor on a pin can replay a recorded
+// trace, so that reads see the jitter, slow edges and glitches of a real
+// sensor: each start signal gets the next read from the trace, going back to
+// the first after the last if loop is set (otherwise the sensor stops
+// answering).  setSensorTimeScale() and MOCK_FAULT_NO_RESPONSE apply to
+// traces too, but the other faults don't.  setSensorTrace() replays the
+// trace where it is, so it must stay around until the pin gets another one
+// (or NULL, to go back to the sensor's values); loadSensorTrace() reads a
+// trace file into memory of its own.  Both return false, and leave the pin
+// as it was, if the trace isn't valid.
+//
+// A trace is a header, then one record per read.  The header is the bytes
+// "DHTTRACE", a version byte (MOCK_TRACE_VERSION), the sensor type (which
+// sets how long a start signal the sensor needs) and the number of ticks
+// per microsecond the record's times are in.  A record is its length in
+// bytes, then the time from each of the sensor's edges to the next,
+// starting from the host letting go of the line: the first edge pulls the
+// line LOW, the next lets it go, and so on.  A whole read is
+// MOCK_TRACE_EDGES_PER_READ edges (the response delay, the signals of
+// DHT::getPulseWidths(), and the LOW after the last bit); a record with no
+// edges is a read the sensor never answered, and one with an odd number
+// leaves the line LOW until the next start signal.  Every number after the
+// header is a varint: 7 bits per byte, low bits first, with the high bit set
+// on all but the last byte.
+#define MOCK_TRACE_VERSION 1
+#define MOCK_TRACE_HEADER_SIZE 11
+#define MOCK_TRACE_EDGES_PER_READ 84
+#define MOCK_TRACE_MAX_EDGES 255
+#define MOCK_TRACE_MAX_RECORD_SIZE (2 + MOCK_TRACE_MAX_EDGES*5)
+boolean setSensorTrace(unsigned int pin, const uint8_t *trace, unsigned long length, boolean loop=true);
+boolean loadSensorTrace(unsigned int pin, const char *path, boolean loop=true);
+
+// these write a trace header, or a record of numEdges times (in ticks) into
+// out, and return the number of bytes written; a record can take up to
+// MOCK_TRACE_MAX_RECORD_SIZE bytes, and any edges past MOCK_TRACE_MAX_EDGES
+// are left out
+unsigned int writeTraceHeader(uint8_t *out, uint8_t sensorType, uint8_t ticksPerMicro);
+unsigned int writeTraceRecord(uint8_t *out, const uint32_t *ticks, unsigned int numEdges);
+
+// counts of what has been asked of the mock environment, for benchmarking;
+// interrupt time covers the span from noInterrupts() to interrupts()
+struct MockStats {
+	unsigned long digitalReads;
+	unsigned long digitalWrites;
+	unsigned long pinModes;
+	unsigned long timeReads;
+	uint64_t interruptsOffMicros;
+	uint64_t maxInterruptsOffMicros;
+};
+void resetMockStats();
+MockStats getMockStats();
+
+// the full 64-bit mock clock, in microseconds
+uint64_t getMockTimeMicros();
+
+// Everything the mock simulates (the clock, the pins and the sensors on
+// them, interrupts and stats) belongs to an environment.  Each thread starts
+// out with an environment of its own, so threads can run simulations side
+// by side.  A thread can also create more, and switch between them with
+// setMockEnvironment() (NULL switches back to its own): that way one thread
+// can run any number of independent simulations, each with its own clock,
+// and a simulation can be handed from one thread to another.  An
+// environment must only be used by one thread at a time, and everything
+// created while using it (a DHT object, say) must only be used with it.
+struct MockEnvironment;
+MockEnvironment* createMockEnvironment();
+void destroyMockEnvironment(MockEnvironment *environment);
+void setMockEnvironment(MockEnvironment *environment);
+
+// a mock timer interrupt, standing in for a hardware timer: handler runs
+// every periodMicros by the mock's clock, just like an external interrupt.
+// A period of 0 stops it.
+void setTimerInterrupt(void (*handler)(), unsigned long periodMicros);
 
 #endif
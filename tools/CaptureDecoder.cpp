@@ -0,0 +1,805 @@
+/***************************************************************************
+ * Streaming decoder for logic analyzer captures of DHT sensor reads, written
+ * as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ *
+ * Reads a VCD file or a sigrok CSV export of one or more data lines, finds
+ * each read (the host's start signal, the sensor's response, and the 40 data
+ * bits) and prints one line per read: its timestamp, the decoded values,
+ * whether the checksum matched (or only matched after error correction), the
+ * 0/1 threshold it was decoded with, and how close the closest bit came to
+ * that threshold.  The file is streamed through
+ * a fixed-size buffer, so captures of any length can be decoded in constant
+ * memory.
+ *
+ * The bits are decoded with DHT::decodePulses(), DHT::correctBits() and
+ * DHTSensorTraits, just as DHT does, so the results match what the library
+ * itself would make of the same signals.
+ *
+ * With -w, every read (including the ones that failed) is also written to a
+ * trace file, in the format described in tests/mocks/WProgram.h, which the
+ * mock environment can replay into the library with loadSensorTrace().  Each
+ * channel gets a trace file of its own, named after the channel, since a
+ * trace only holds the reads of one sensor.
+ ***************************************************************************/
+
+#include "DHT.h"
+#include "ctype.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+// anything LOW for at least this long is a host start signal (the DHT22
+// needs at least 1 millisecond, and the library sends 20)
+#define MIN_START_SIGNAL_PS 500000000LL
+// any other signal longer than this is a timeout, as in DHT::timeSignalLength()
+#define SIGNAL_TIMEOUT_PS 200000000LL
+
+#define MAX_CHANNELS 64
+#define READ_BUFFER_SIZE (1<<20)
+
+#define STATE_IDLE    0
+#define STATE_RELEASE 1
+#define STATE_PULSES  2
+// after a whole read, waiting for the end of the LOW after the last bit,
+// which only a trace needs
+#define STATE_FINAL   3
+
+// the resolution traces are written with
+#define TRACE_TICKS_PER_MICRO 16
+
+
+struct Channel {
+	char name[32];
+	int level;
+	long long lastEdge;
+	int state;
+	long long frameStart;
+	uint32_t responseNanos;
+	uint8_t numPulses;
+	// the signals of the read, and the LOW after them, for traces
+	uint32_t pulseNanos[DHT_NUM_PULSES + 1];
+
+	// corrected frames are also counted as good ones
+	unsigned long frames, goodFrames, correctedFrames, checksumErrors, timeouts, noResponses;
+	double worstMargin;
+
+	// opened when the first read is written to it
+	FILE *traceFile;
+	unsigned long traceRecords;
+};
+
+struct Options {
+	uint8_t sensorType;
+	boolean verbose;
+	boolean summaryOnly;
+	double sampleRate;
+	const char *tracePrefix;
+};
+
+static Channel channels_[MAX_CHANNELS];
+static int numChannels_ = 0;
+static unsigned long long numEdges_ = 0;
+static Options options_;
+
+
+// --- frame decoding --------------------------------------------------------
+
+// a channel's trace file is the -w prefix followed by the channel's name
+// (and its number, if an earlier channel has the same name), with anything
+// that doesn't belong in a file name replaced
+static void getTracePath(const Channel &channel, char *path, size_t size) {
+	size_t prefixLength;
+	int index = &channel - channels_, i;
+	char *c;
+
+	for (i = 0; i < index && strcmp(channels_[i].name, channel.name) != 0; i++) {
+		// keep looking
+	}
+	if (i < index) {
+		snprintf(path, size, "%s%s-%d.trace", options_.tracePrefix, channel.name, index);
+	} else {
+		snprintf(path, size, "%s%s.trace", options_.tracePrefix, channel.name);
+	}
+	prefixLength = strlen(options_.tracePrefix);
+	for (c = path + ((prefixLength < size) ? prefixLength : size-1); *c; c++) {
+		if (!isalnum((unsigned char)*c) && *c != '.' && *c != '-' && *c != '_') {
+			*c = '_';
+		}
+	}
+}
+
+// writes a read to the channel's trace file: the response delay and the
+// first numPulses pulses, or nothing at all if the sensor never responded
+static void recordTrace(Channel &channel, int numPulses) {
+	uint32_t ticks[DHT_NUM_PULSES + 2];
+	uint8_t record[MOCK_TRACE_MAX_RECORD_SIZE];
+	char path[FILENAME_MAX];
+	int numEdges = 0;
+
+	if (!options_.tracePrefix) {
+		return;
+	}
+	if (!channel.traceFile) {
+		getTracePath(channel, path, sizeof(path));
+		channel.traceFile = fopen(path, "wb");
+		if (!channel.traceFile) {
+			perror(path);
+			exit(1);
+		}
+		fwrite(record, 1, writeTraceHeader(record, options_.sensorType, TRACE_TICKS_PER_MICRO), channel.traceFile);
+	}
+	if (numPulses >= 0) {
+		ticks[numEdges++] = ((uint64_t)channel.responseNanos * TRACE_TICKS_PER_MICRO + 500) / 1000;
+		for (int i = 0; i < numPulses; i++) {
+			ticks[numEdges++] = ((uint64_t)channel.pulseNanos[i] * TRACE_TICKS_PER_MICRO + 500) / 1000;
+		}
+	}
+	fwrite(record, 1, writeTraceRecord(record, ticks, numEdges), channel.traceFile);
+	channel.traceRecords++;
+}
+
+static void printFrameStart(Channel &channel, const char *status) {
+	printf("%.9f,%s,%s", channel.frameStart / 1e12, channel.name, status);
+}
+
+static void reportFailure(Channel &channel, const char *status, int pulseIndex) {
+	channel.frames++;
+	// a read that was cut short leaves the line wherever it was
+	recordTrace(channel, (channel.state == STATE_PULSES) ? channel.numPulses : -1);
+	if (options_.summaryOnly) {
+		return;
+	}
+	printFrameStart(channel, status);
+	printf(",,,,,%d\n", pulseIndex);
+}
+
+static void reportFrame(Channel &channel) {
+	uint8_t pulses[DHT_NUM_PULSES];
+	uint8_t data[DHT_NUM_BYTES];
+	int16_t temperatureTenths;
+	uint16_t humidityTenths;
+	uint8_t threshold;
+	double margin, worstMargin;
+	boolean valid, corrected;
+	int i;
+
+	// the library works in whole microseconds, capped at a byte
+	for (i = 0; i < DHT_NUM_PULSES; i++) {
+		pulses[i] = (channel.pulseNanos[i] >= 255000) ? 255 : (channel.pulseNanos[i] + 500) / 1000;
+	}
+	valid = DHT::decodePulses(pulses, data);
+	threshold = DHT::computeBitThreshold(pulses);
+
+	// give a bad frame the same second chance DHT::decodeCapture() does
+	corrected = false;
+	if (!valid) {
+		corrected = DHT::correctBits(pulses, data, (options_.sensorType == DHT_SENSOR_TYPE_DHT11) ?
+			DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::isPlausible : DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::isPlausible);
+		valid = corrected;
+	}
+
+	// how close did the closest bit come to being read the other way?
+	worstMargin = 1e9;
+	for (i = 3; i < DHT_NUM_PULSES; i += 2) {
+		margin = channel.pulseNanos[i] / 1000.0 - threshold;
+		margin = (margin < 0) ? -margin : margin;
+		if (margin < worstMargin) {
+			worstMargin = margin;
+		}
+	}
+	if (worstMargin < channel.worstMargin) {
+		channel.worstMargin = worstMargin;
+	}
+
+	channel.frames++;
+	if (valid) {
+		channel.goodFrames++;
+		if (corrected) {
+			channel.correctedFrames++;
+		}
+	} else {
+		channel.checksumErrors++;
+	}
+	if (options_.summaryOnly) {
+		return;
+	}
+
+	if (options_.sensorType == DHT_SENSOR_TYPE_DHT11) {
+		temperatureTenths = DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::decodeTemperatureTenths(data);
+		humidityTenths = DHTSensorTraits<DHT_SENSOR_TYPE_DHT11>::decodeHumidityTenths(data);
+	} else {
+		temperatureTenths = DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::decodeTemperatureTenths(data);
+		humidityTenths = DHTSensorTraits<DHT_SENSOR_TYPE_DHT22>::decodeHumidityTenths(data);
+	}
+
+	printFrameStart(channel, corrected ? "corrected" : (valid ? "ok" : "checksum"));
+	printf(",%.1f,%.1f,%02x%02x%02x%02x%02x,%u,%.2f,", humidityTenths / 10.0, temperatureTenths / 10.0,
+		data[4], data[3], data[2], data[1], data[0], threshold, worstMargin);
+	if (options_.verbose) {
+		for (i = 0; i < DHT_NUM_PULSES; i++) {
+			printf("%s%.2f", i ? " " : "", channel.pulseNanos[i] / 1000.0);
+		}
+	}
+	printf("\n");
+}
+
+static inline void handleEdge(Channel &channel, long long time, int level) {
+	long long signalLength;
+	int endedLevel;
+
+	if (level == channel.level) {
+		return;
+	}
+	endedLevel = channel.level;
+	signalLength = time - channel.lastEdge;
+	channel.level = level;
+	channel.lastEdge = time;
+	if (endedLevel < 0) {
+		// this was just the initial value
+		return;
+	}
+	numEdges_++;
+
+	if (channel.state == STATE_FINAL) {
+		// the sensor letting go of the line after a read; anything else
+		// leaves the line LOW at the end of the trace's read
+		if (endedLevel == LOW && signalLength <= SIGNAL_TIMEOUT_PS) {
+			channel.pulseNanos[DHT_NUM_PULSES] = signalLength / 1000;
+			recordTrace(channel, DHT_NUM_PULSES + 1);
+		} else {
+			recordTrace(channel, DHT_NUM_PULSES);
+		}
+		channel.state = STATE_IDLE;
+	}
+
+	if (endedLevel == LOW && signalLength >= MIN_START_SIGNAL_PS) {
+		// a start signal, so any read that was in progress is abandoned
+		if (channel.state != STATE_IDLE) {
+			channel.timeouts++;
+			reportFailure(channel, "timeout", channel.numPulses);
+		}
+		channel.state = STATE_RELEASE;
+		channel.frameStart = time - signalLength;
+		return;
+	}
+
+	switch (channel.state) {
+		case STATE_RELEASE:
+			// the host has let go of the line, and the sensor just pulled it
+			// LOW to start its response... or never did
+			if (signalLength > SIGNAL_TIMEOUT_PS) {
+				channel.noResponses++;
+				reportFailure(channel, "no-response", 0);
+				channel.state = STATE_IDLE;
+				return;
+			}
+			channel.responseNanos = signalLength / 1000;
+			channel.numPulses = 0;
+			channel.state = STATE_PULSES;
+			return;
+		case STATE_PULSES:
+			if (signalLength > SIGNAL_TIMEOUT_PS) {
+				channel.timeouts++;
+				reportFailure(channel, "timeout", channel.numPulses);
+				channel.state = STATE_IDLE;
+				return;
+			}
+			channel.pulseNanos[channel.numPulses++] = signalLength / 1000;
+			if (channel.numPulses == DHT_NUM_PULSES) {
+				reportFrame(channel);
+				channel.state = options_.tracePrefix ? STATE_FINAL : STATE_IDLE;
+			}
+			return;
+	}
+}
+
+static int addChannel(const char *name, size_t length) {
+	if (numChannels_ >= MAX_CHANNELS) {
+		fprintf(stderr, "too many channels; only the first %d are decoded\n", MAX_CHANNELS);
+		return -1;
+	}
+
+	Channel &channel = channels_[numChannels_];
+	memset(&channel, 0, sizeof(channel));
+	if (length >= sizeof(channel.name)) {
+		length = sizeof(channel.name) - 1;
+	}
+	memcpy(channel.name, name, length);
+	channel.level = -1;
+	channel.worstMargin = 1e9;
+	return numChannels_++;
+}
+
+
+// --- buffered input --------------------------------------------------------
+
+class Reader {
+
+	public:
+
+		Reader(FILE *file) : file_(file), start_(0), end_(0), eof_(false) {
+			buffer_ = new char[READ_BUFFER_SIZE + 1];
+		}
+		~Reader() {
+			delete[] buffer_;
+		}
+
+		// returns the next line, without its line ending, or NULL at the end
+		// of the file; lines longer than the buffer are truncated
+		char* nextLine(size_t &length) {
+			char *line, *newline;
+
+			for (;;) {
+				newline = (char*)memchr(buffer_ + start_, '\n', end_ - start_);
+				if (newline || eof_ || (start_ == 0 && end_ == READ_BUFFER_SIZE)) {
+					break;
+				}
+				refill();
+			}
+			if (start_ == end_ && eof_) {
+				return NULL;
+			}
+
+			line = buffer_ + start_;
+			if (newline) {
+				length = newline - line;
+				start_ += length + 1;
+			} else {
+				length = end_ - start_;
+				start_ = end_;
+			}
+			if (length > 0 && line[length-1] == '\r') {
+				length--;
+			}
+			line[length] = '\0';
+			return line;
+		}
+
+	private:
+
+		FILE *file_;
+		char *buffer_;
+		size_t start_, end_;
+		boolean eof_;
+
+		void refill() {
+			size_t count;
+
+			memmove(buffer_, buffer_ + start_, end_ - start_);
+			end_ -= start_;
+			start_ = 0;
+			count = fread(buffer_ + end_, 1, READ_BUFFER_SIZE - end_, file_);
+			end_ += count;
+			if (count == 0) {
+				eof_ = true;
+			}
+		}
+
+};
+
+static inline const char* skipSpaces(const char *p) {
+	while (*p == ' ' || *p == '\t') {
+		p++;
+	}
+	return p;
+}
+
+static inline long long parseUnsigned(const char *p) {
+	long long value = 0;
+
+	while (*p >= '0' && *p <= '9') {
+		value = value * 10 + (*p++ - '0');
+	}
+	return value;
+}
+
+static inline const char* skipToken(const char *p) {
+	while (*p && *p != ' ' && *p != '\t') {
+		p++;
+	}
+	return p;
+}
+
+
+// --- VCD -------------------------------------------------------------------
+
+// maps single-character VCD identifiers (by far the most common) straight to
+// a channel, and falls back to a search for longer ones
+static int vcdShortIds_[128];
+static char vcdLongIds_[MAX_CHANNELS][16];
+
+static int findVcdChannel(const char *id, size_t length) {
+	int i;
+
+	if (length == 1) {
+		return vcdShortIds_[(uint8_t)id[0] & 0x7F];
+	}
+	for (i = 0; i < numChannels_; i++) {
+		if (strlen(vcdLongIds_[i]) == length && memcmp(vcdLongIds_[i], id, length) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static double parseTimescalePs(const char *text) {
+	double value = strtod(text, (char**)&text);
+
+	text = skipSpaces(text);
+	if (value == 0) {
+		value = 1;
+	}
+	switch (text[0]) {
+		case 's': return value * 1e12;
+		case 'm': return value * 1e9;
+		case 'u': return value * 1e6;
+		case 'n': return value * 1e3;
+		case 'p': return value;
+		case 'f': return value * 1e-3;
+	}
+	return value;
+}
+
+static void decodeVcd(Reader &reader) {
+	char *line;
+	const char *p, *token, *end;
+	size_t length;
+	boolean inHeader = true, inComment = false;
+	char pendingKeyword[32] = "";
+	char headerText[256] = "";
+	double psPerUnit = 1;
+	long long psPerUnitInt = 1;
+	long long time = 0;
+	int channel;
+
+	memset(vcdShortIds_, 0xFF, sizeof(vcdShortIds_));
+
+	while ((line = reader.nextLine(length))) {
+		p = skipSpaces(line);
+
+		if (inHeader) {
+			// the header is made of "$keyword ... $end" sections, which may
+			// span lines, so gather up each one before looking at it
+			while (*p) {
+				token = p;
+				end = skipToken(p);
+				p = skipSpaces(end);
+				if (pendingKeyword[0] == '\0') {
+					if (*token == '$') {
+						snprintf(pendingKeyword, sizeof(pendingKeyword), "%.*s", (int)(end - token), token);
+						headerText[0] = '\0';
+					}
+					continue;
+				}
+				if (end - token == 4 && memcmp(token, "$end", 4) == 0) {
+					if (strcmp(pendingKeyword, "$timescale") == 0) {
+						psPerUnit = parseTimescalePs(headerText);
+						if (psPerUnit < 1) {
+							fprintf(stderr, "timescales finer than 1ps aren't supported\n");
+							exit(1);
+						}
+						psPerUnitInt = (long long)psPerUnit;
+					} else if (strcmp(pendingKeyword, "$var") == 0) {
+						// $var type size identifier name [index] $end
+						char type[32], id[16], name[32];
+						int size;
+						if (sscanf(headerText, "%31s %d %15s %31s", type, &size, id, name) == 4 && size == 1) {
+							channel = addChannel(name, strlen(name));
+							if (channel >= 0) {
+								strcpy(vcdLongIds_[channel], id);
+								if (strlen(id) == 1) {
+									vcdShortIds_[(uint8_t)id[0] & 0x7F] = channel;
+								}
+							}
+						}
+					} else if (strcmp(pendingKeyword, "$enddefinitions") == 0) {
+						inHeader = false;
+					}
+					pendingKeyword[0] = '\0';
+					continue;
+				}
+				if (strlen(headerText) + (end - token) + 2 < sizeof(headerText)) {
+					strncat(headerText, token, end - token);
+					strcat(headerText, " ");
+				}
+			}
+			continue;
+		}
+
+		// the body is a series of timestamps and value changes, usually one
+		// per line, so handle those before falling back to splitting the line
+		// into tokens
+		if (!inComment) {
+			if (line[0] == '#' && line[1] >= '0' && line[1] <= '9') {
+				end = line + 1;
+				time = 0;
+				while (*end >= '0' && *end <= '9') {
+					time = time * 10 + (*end++ - '0');
+				}
+				if (*end == '\0') {
+					time *= psPerUnitInt;
+					continue;
+				}
+			} else if ((line[0] == '0' || line[0] == '1') && length == 2) {
+				channel = vcdShortIds_[(uint8_t)line[1] & 0x7F];
+				if (channel >= 0) {
+					handleEdge(channels_[channel], time, line[0] - '0');
+				}
+				continue;
+			}
+		}
+		while (*p) {
+			token = p;
+			end = skipToken(p);
+			p = skipSpaces(end);
+
+			if (inComment) {
+				if (end - token == 4 && memcmp(token, "$end", 4) == 0) {
+					inComment = false;
+				}
+				continue;
+			}
+
+			switch (*token) {
+				case '#':
+					time = parseUnsigned(token + 1) * psPerUnitInt;
+					break;
+				case '0':
+				case '1':
+					channel = findVcdChannel(token + 1, end - token - 1);
+					if (channel >= 0) {
+						handleEdge(channels_[channel], time, *token - '0');
+					}
+					break;
+				case 'b':
+				case 'B':
+				case 'r':
+				case 'R':
+					// a vector or real value, followed by its identifier
+					p = skipSpaces(skipToken(p));
+					break;
+				case '$':
+					// $dumpvars, $end and friends just bracket value
+					// changes, but a $comment has to be skipped entirely
+					if (end - token == 8 && memcmp(token, "$comment", 8) == 0) {
+						inComment = true;
+					}
+					break;
+			}
+		}
+	}
+}
+
+
+// --- sigrok CSV ------------------------------------------------------------
+
+static double parseSampleRate(const char *text) {
+	double value = strtod(text, (char**)&text);
+
+	text = skipSpaces(text);
+	switch (text[0]) {
+		case 'k': return value * 1e3;
+		case 'M': return value * 1e6;
+		case 'G': return value * 1e9;
+	}
+	return value;
+}
+
+static void decodeCsv(Reader &reader) {
+	char *line;
+	const char *p, *field;
+	size_t length, previousLength = 0;
+	char *previousLine = new char[READ_BUFFER_SIZE + 1];
+	int columnChannels[MAX_CHANNELS + 1];
+	int numColumns = 0, timeColumn = -1, column;
+	double sampleRate = options_.sampleRate;
+	unsigned long long sampleIndex = 0;
+	long long time;
+	boolean haveHeader = false;
+
+	while ((line = reader.nextLine(length))) {
+		if (length == 0) {
+			continue;
+		}
+		if (line[0] == ';') {
+			// sigrok's comments include the sample rate
+			p = strstr(line, "Samplerate:");
+			if (p && options_.sampleRate == 0) {
+				sampleRate = parseSampleRate(p + 11);
+			}
+			continue;
+		}
+
+		if (!haveHeader) {
+			haveHeader = true;
+			if ((line[0] < '0' || line[0] > '9') && line[0] != '-' && line[0] != '.') {
+				// column names: a "time" column holds seconds, and the rest
+				// are channels
+				for (p = line; numColumns <= MAX_CHANNELS; p++) {
+					field = p;
+					while (*p && *p != ',') {
+						p++;
+					}
+					if (strncasecmp(field, "time", 4) == 0) {
+						timeColumn = numColumns;
+						columnChannels[numColumns++] = -1;
+					} else {
+						columnChannels[numColumns++] = addChannel(field, p - field);
+					}
+					if (!*p) {
+						break;
+					}
+				}
+				continue;
+			}
+			// no column names, so make some up
+			for (p = line, numColumns = 0; numColumns < MAX_CHANNELS; p++) {
+				char name[16];
+				snprintf(name, sizeof(name), "D%d", numColumns);
+				columnChannels[numColumns++] = addChannel(name, strlen(name));
+				while (*p && *p != ',') {
+					p++;
+				}
+				if (!*p) {
+					break;
+				}
+			}
+		}
+
+		// most samples are the same as the one before, and there's nothing to
+		// do for those unless we need to track the time column
+		if (timeColumn < 0 && length == previousLength && memcmp(line, previousLine, length) == 0) {
+			sampleIndex++;
+			continue;
+		}
+
+		if (timeColumn < 0) {
+			if (sampleRate <= 0) {
+				fprintf(stderr, "no sample rate found in the file; use -r\n");
+				exit(1);
+			}
+			time = (long long)(sampleIndex * (1e12 / sampleRate));
+		} else {
+			time = 0;
+		}
+
+		for (p = line, column = 0; column < numColumns; column++) {
+			if (column == timeColumn) {
+				time = (long long)(strtod(p, (char**)&p) * 1e12);
+			} else if (columnChannels[column] >= 0 && (*p == '0' || *p == '1')) {
+				// we don't know the time yet if the time column comes later,
+				// but sigrok always puts it first
+				handleEdge(channels_[columnChannels[column]], time, *p - '0');
+			}
+			while (*p && *p != ',') {
+				p++;
+			}
+			if (*p) {
+				p++;
+			}
+		}
+
+		memcpy(previousLine, line, length);
+		previousLength = length;
+		sampleIndex++;
+	}
+
+	delete[] previousLine;
+}
+
+
+// --- main ------------------------------------------------------------------
+
+static void usage() {
+	fprintf(stderr,
+		"usage: capture_decoder.out [options] <file.vcd|file.csv|->\n"
+		"  -f vcd|csv   input format (default: guessed from the file name)\n"
+		"  -t 11|21|22  sensor type, for decoding values (default: 22)\n"
+		"  -r rate      sample rate in Hz, for CSV files without one\n"
+		"  -v           include every signal length (in microseconds)\n"
+		"  -s           only print the per-channel summary\n"
+		"  -w prefix    also write every read to a trace file per channel, named\n"
+		"               <prefix><channel>.trace, for the mock to replay\n");
+	exit(1);
+}
+
+int main(int argc, char** argv) {
+	const char *path = NULL, *format = NULL;
+	char tracePath[FILENAME_MAX];
+	FILE *file;
+	double start, seconds;
+	struct timespec now;
+	int i;
+
+	options_.sensorType = DHT_SENSOR_TYPE_DHT22;
+	options_.verbose = false;
+	options_.summaryOnly = false;
+	options_.sampleRate = 0;
+	options_.tracePrefix = NULL;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i+1 < argc) {
+			format = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+			options_.sensorType = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+			options_.sampleRate = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-v") == 0) {
+			options_.verbose = true;
+		} else if (strcmp(argv[i], "-s") == 0) {
+			options_.summaryOnly = true;
+		} else if (strcmp(argv[i], "-w") == 0 && i+1 < argc) {
+			options_.tracePrefix = argv[++i];
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			usage();
+		} else {
+			path = argv[i];
+		}
+	}
+	if (!path) {
+		usage();
+	}
+	if (!format) {
+		format = (strlen(path) > 4 && strcasecmp(path + strlen(path) - 4, ".csv") == 0) ? "csv" : "vcd";
+	}
+
+	file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	start = now.tv_sec + now.tv_nsec * 1e-9;
+
+	if (!options_.summaryOnly) {
+		printf("time_s,channel,status,humidity,temperature_c,raw,threshold_us,worst_margin_us,%s\n", options_.verbose ? "pulses_us" : "failed_at_pulse");
+	}
+	Reader reader(file);
+	if (strcmp(format, "csv") == 0) {
+		decodeCsv(reader);
+	} else {
+		decodeVcd(reader);
+	}
+
+	// anything still in progress at the end of the capture never finished
+	for (i = 0; i < numChannels_; i++) {
+		if (channels_[i].state == STATE_FINAL) {
+			recordTrace(channels_[i], DHT_NUM_PULSES);
+		} else if (channels_[i].state != STATE_IDLE) {
+			channels_[i].timeouts++;
+			reportFailure(channels_[i], "truncated", channels_[i].numPulses);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	seconds = now.tv_sec + now.tv_nsec * 1e-9 - start;
+
+	fflush(stdout);
+	for (i = 0; i < numChannels_; i++) {
+		Channel &channel = channels_[i];
+		fprintf(stderr, "%s: %lu reads, %lu ok (%lu corrected), %lu checksum errors, %lu timeouts, %lu without response",
+			channel.name, channel.frames, channel.goodFrames, channel.correctedFrames, channel.checksumErrors, channel.timeouts,
+			channel.noResponses);
+		if (channel.worstMargin < 1e9) {
+			fprintf(stderr, ", worst bit margin %.2fus", channel.worstMargin);
+		}
+		fprintf(stderr, "\n");
+	}
+	fprintf(stderr, "%llu edges in %.3fs (%.1f million edges/s)\n", numEdges_, seconds, numEdges_ / seconds / 1e6);
+	for (i = 0; i < numChannels_; i++) {
+		if (channels_[i].traceFile) {
+			fclose(channels_[i].traceFile);
+			getTracePath(channels_[i], tracePath, sizeof(tracePath));
+			fprintf(stderr, "%lu reads written to %s\n", channels_[i].traceRecords, tracePath);
+		}
+	}
+
+	if (file != stdin) {
+		fclose(file);
+	}
+	return 0;
+}
@@ -0,0 +1,207 @@
+/***************************************************************************
+ * Reader for binary logs written by DHTLog, written as part of:
+ * https://github.com/zacronos/DHT-sensor-library
+ * written by Joe Ibershoff
+ * distributed under MIT license
+ *
+ * Memory-maps a log file (blocks written by DHTLog, one after another) and
+ * decodes every block straight into columns: one array each of sensor ids,
+ * timestamps, flags, temperatures and humidities.  The columns are then
+ * printed as CSV, or just summarized.  Damaged blocks are skipped (and
+ * counted), so the rest of a log can still be read.
+ *
+ * The blocks are decoded with DHTLog::decodeBlock(), which decodes the raw
+ * values with DHTSensorTraits, so the results match what the library's
+ * get*() functions returned when the readings were logged.
+ ***************************************************************************/
+
+#include "DHTLog.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+
+struct Columns {
+	size_t size;
+	uint8_t *sensorIds;
+	uint32_t *timestamps;
+	uint8_t *flags;
+	int16_t *temperatureTenthsC;
+	int16_t *humidityTenths;
+};
+
+struct Options {
+	boolean summaryOnly;
+	boolean includeFailures;
+};
+
+static const char *statusNames_[] = {"in_progress", "ok", "not_started", "timeout", "checksum_error", "disconnected", "6", "7"};
+static Options options_;
+
+
+static void allocateColumns(Columns &columns, size_t size) {
+	columns.size = 0;
+	columns.sensorIds = (uint8_t*)malloc(size);
+	columns.timestamps = (uint32_t*)malloc(size * sizeof(uint32_t));
+	columns.flags = (uint8_t*)malloc(size);
+	columns.temperatureTenthsC = (int16_t*)malloc(size * sizeof(int16_t));
+	columns.humidityTenths = (int16_t*)malloc(size * sizeof(int16_t));
+	if (!columns.sensorIds || !columns.timestamps || !columns.flags || !columns.temperatureTenthsC || !columns.humidityTenths) {
+		fprintf(stderr, "out of memory for %lu readings\n", (unsigned long)size);
+		exit(1);
+	}
+}
+
+// the first pass just walks the block headers, to find out how big the
+// columns need to be; returns the number of readings
+static size_t countRecords(const uint8_t *log, size_t length) {
+	size_t offset = 0, total = 0;
+
+	while (offset < length) {
+		if (!DHTLog::isValidBlock(log + offset, length - offset)) {
+			// a damaged block; assume it was the same size as the first one
+			offset += DHTLog::isValidBlock(log, length) ? DHTLog::getBlockSize(log) : length;
+			continue;
+		}
+		total += DHTLog::getBlockNumRecords(log + offset);
+		offset += DHTLog::getBlockSize(log + offset);
+	}
+	return total;
+}
+
+// the second pass decodes each block directly into its slice of the columns;
+// returns the number of damaged blocks
+static unsigned long decodeLog(const uint8_t *log, size_t length, Columns &columns, unsigned long &numBlocks) {
+	size_t offset = 0;
+	unsigned long damaged = 0;
+	int32_t numRecords;
+	const uint8_t *block;
+
+	numBlocks = 0;
+	while (offset < length) {
+		block = log + offset;
+		numBlocks++;
+		if (!DHTLog::isValidBlock(block, length - offset)) {
+			damaged++;
+			offset += DHTLog::isValidBlock(log, length) ? DHTLog::getBlockSize(log) : length;
+			continue;
+		}
+		offset += DHTLog::getBlockSize(block);
+
+		numRecords = DHTLog::decodeBlock(block, columns.timestamps + columns.size, columns.flags + columns.size,
+			columns.temperatureTenthsC + columns.size, columns.humidityTenths + columns.size);
+		if (numRecords < 0) {
+			// whatever was decoded before the damage is dropped along with it
+			damaged++;
+			continue;
+		}
+		memset(columns.sensorIds + columns.size, DHTLog::getBlockSensorId(block), numRecords);
+		columns.size += numRecords;
+	}
+	return damaged;
+}
+
+static void printColumns(const Columns &columns) {
+	size_t i;
+
+	printf("time_ms,sensor,status,humidity,temperature_c,corrected,fallback\n");
+	for (i = 0; i < columns.size; i++) {
+		if (!(columns.flags[i] & DHT_LOG_FLAG_VALUES)) {
+			if (options_.includeFailures) {
+				printf("%lu,%u,%s,,,,\n", (unsigned long)columns.timestamps[i], columns.sensorIds[i],
+					statusNames_[columns.flags[i] & DHT_LOG_STATUS_MASK]);
+			}
+			continue;
+		}
+		// the same scaling getPercentHumidity() and getTemperatureCelsius() use
+		printf("%lu,%u,%s,%.1f,%.1f,%d,%d\n", (unsigned long)columns.timestamps[i], columns.sensorIds[i],
+			statusNames_[columns.flags[i] & DHT_LOG_STATUS_MASK],
+			columns.humidityTenths[i]/10.0, columns.temperatureTenthsC[i]/10.0,
+			(columns.flags[i] & DHT_LOG_FLAG_CORRECTED) ? 1 : 0, (columns.flags[i] & DHT_LOG_FLAG_FALLBACK) ? 1 : 0);
+	}
+}
+
+static void usage() {
+	fprintf(stderr,
+		"usage: log_reader.out [options] <file.log>\n"
+		"  -a           also print reads that have no values\n"
+		"  -s           only print the summary\n");
+	exit(1);
+}
+
+int main(int argc, char** argv) {
+	const char *path = NULL;
+	const uint8_t *log;
+	struct stat info;
+	Columns columns;
+	unsigned long numBlocks, damaged, withValues;
+	double start, seconds;
+	struct timespec now;
+	size_t i;
+	int fd;
+
+	options_.summaryOnly = false;
+	options_.includeFailures = false;
+
+	for (i = 1; i < (size_t)argc; i++) {
+		if (strcmp(argv[i], "-a") == 0) {
+			options_.includeFailures = true;
+		} else if (strcmp(argv[i], "-s") == 0) {
+			options_.summaryOnly = true;
+		} else if (argv[i][0] == '-') {
+			usage();
+		} else {
+			path = argv[i];
+		}
+	}
+	if (!path) {
+		usage();
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &info) < 0) {
+		perror(path);
+		return 1;
+	}
+	if (info.st_size == 0) {
+		fprintf(stderr, "%s: empty log\n", path);
+		return 1;
+	}
+	log = (const uint8_t*)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (log == MAP_FAILED) {
+		perror(path);
+		return 1;
+	}
+	madvise((void*)log, info.st_size, MADV_SEQUENTIAL);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	start = now.tv_sec + now.tv_nsec * 1e-9;
+
+	allocateColumns(columns, countRecords(log, info.st_size));
+	damaged = decodeLog(log, info.st_size, columns, numBlocks);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	seconds = now.tv_sec + now.tv_nsec * 1e-9 - start;
+
+	if (!options_.summaryOnly) {
+		printColumns(columns);
+	}
+
+	withValues = 0;
+	for (i = 0; i < columns.size; i++) {
+		if (columns.flags[i] & DHT_LOG_FLAG_VALUES) {
+			withValues++;
+		}
+	}
+	fflush(stdout);
+	fprintf(stderr, "%lu blocks (%lu damaged), %lu reads, %lu with values\n", numBlocks, damaged, (unsigned long)columns.size, withValues);
+	fprintf(stderr, "decoded in %.3fs (%.1f million reads/s)\n", seconds, columns.size / seconds / 1e6);
+
+	munmap((void*)log, info.st_size);
+	close(fd);
+	return 0;
+}